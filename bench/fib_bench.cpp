@@ -0,0 +1,57 @@
+// 経路のないInterestに対するGatewayFIB::lookupの所要時間（否定キャッシュの有無で比較）
+// 使い方: fib_bench [回数]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "gateway_fib.h"
+
+static double measure(GatewayFIB& fib, const std::vector<std::string>& names, size_t iterations) {
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        found += fib.lookup(names[i % names.size()]).size();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (found != 0) {
+        std::fprintf(stderr, "unexpected route found\n");
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    MacAddress mac;
+    MacAddress::parse("AA:BB:CC:DD:EE:FF", mac);
+
+    // 満杯のFIBと、どのプレフィックスにも一致しない深さ5の名前
+    GatewayFIB fib;
+    for (size_t i = 0; i < GatewayFIB::kCapacity; i++) {
+        fib.learn("/sensor/room" + std::to_string(i) + "/temp", mac);
+    }
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 1024; i++) {
+        names.push_back("/scan/" + std::to_string(i) + "/a/b/c");
+    }
+
+    fib.setFilterEnabled(false);
+    measure(fib, names, iterations / 10);
+    double without_filter = measure(fib, names, iterations);
+
+    fib.setFilterEnabled(true);
+    measure(fib, names, iterations / 10);
+    double with_filter = measure(fib, names, iterations);
+
+    GatewayFIB::FilterStats stats = fib.filterStats();
+    std::printf("miss path (%zu lookups, %zu entries)\n", iterations, fib.size());
+    std::printf("  filter disabled: %8.1f ns/lookup\n", without_filter);
+    std::printf("  filter enabled:  %8.1f ns/lookup (rejected=%llu false_positives=%llu)\n", with_filter,
+                static_cast<unsigned long long>(stats.rejected),
+                static_cast<unsigned long long>(stats.falsePositives));
+    return 0;
+}
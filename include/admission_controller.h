@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include "icsn_packet.h"
+#include "mac_address.h"
+#include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+
+// センサー宛Interestの流量制御設定（既定は無効）
+struct AdmissionConfig {
+    bool enabled = false;
+    uint32_t mac_rate = 5;          // 宛先MACごとのInterest/秒
+    uint32_t mac_burst = 10;        // 宛先MACごとのバースト許容数
+    uint32_t prefix_rate = 20;      // プレフィックスごとのInterest/秒
+    uint32_t prefix_burst = 40;
+    size_t prefix_depth = 2;        // プレフィックスとみなす名前の階層数（/sensor/room1）
+    uint32_t serial_share = 50;     // TXに使ってよいシリアル帯域の割合（%）
+    uint32_t defer_timeout_ms = 1000;   // 保留したInterestの有効期間
+};
+
+// トークンバケットによるInterest送信の許可制御
+// 宛先MAC・名前プレフィックス・シリアル帯域（ボーレート/10 バイト/秒）の3つのバケットを
+// すべて満たした場合だけ送信を許可する
+// 超過分は保留可能なら固定長キューで待たせ、新しいInterestの判定前と周期処理で再試行する（満杯・期限切れは破棄）
+class AdmissionController {
+public:
+    static constexpr size_t kMaxDeferred = 32;
+    static constexpr size_t kMaxMacBuckets = 64;
+    static constexpr size_t kMaxPrefixBuckets = 128;
+
+    enum class Decision {
+        Admit,      // 送信してよい（トークン消費済み）
+        Defer,      // 保留キューに入れた
+        Drop,       // 破棄
+    };
+
+    struct Stats {
+        uint64_t admitted = 0;
+        uint64_t deferred = 0;          // 一度保留されたもの
+        uint64_t retried = 0;           // 保留後に送信できたもの
+        uint64_t dropped_mac = 0;       // MACごとの上限超過で破棄
+        uint64_t dropped_prefix = 0;    // プレフィックスごとの上限超過で破棄
+        uint64_t dropped_serial = 0;    // シリアル帯域超過で破棄
+        uint64_t dropped_queue = 0;     // 保留キュー満杯で破棄
+        uint64_t dropped_send = 0;      // 保留後に許可されたが送信に失敗（TXキュー満杯・書き込み失敗）
+        uint64_t expired = 0;           // 保留中に期限切れ
+    };
+
+    AdmissionController(const AdmissionConfig& config, int baudrate);
+
+    // 宛先macへのInterestフレーム（wire_bytesはTX行の長さ）の送信可否を判定
+    // deferrable=trueで超過時はフレームを保留キューへコピーしてDeferを返す
+    Decision admit(const MacAddress& mac, std::string_view content_name,
+                   const uint8_t* frame, size_t frame_len, size_t wire_bytes,
+                   bool deferrable);
+
+    // 保留キューを先頭から再判定し、許可されたものをsend(mac, frame, len)で送る
+    // sendは送れたらtrueを返すこと（失敗したものは破棄として数える）。送信数を返す
+    template<typename Send>
+    size_t retryDeferred(Send&& send);
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+    // レート・バースト・シリアル帯域の割合を実行中に変更する（既存のバケットは次の補充から従う）
+    AdmissionConfig config() const;
+    // limitsのうちmac_rate/mac_burst/prefix_rate/prefix_burst/serial_shareを反映
+    void setLimits(const AdmissionConfig& limits);
+    // 保持中のバケット数・保留数
+    void reportOccupancy(std::ostream& os) const;
+
+private:
+    struct TokenBucket {
+        double tokens = -1.0;   // 負: 未初期化（初回はバースト分で満たす）
+        uint64_t lastMs = 0;
+    };
+
+    struct DeferredInterest {
+        MacAddress mac;
+        uint64_t enqueuedMs;
+        size_t wireBytes;
+        uint8_t nameLen;
+        uint8_t frameLen;
+        char name[sizeof(CommunicationData::contentName)];
+        uint8_t frame[IcsnPacketView::kMaxFrameSize];
+    };
+
+    enum class Limit { None, Mac, Prefix, Serial };
+
+    Limit tryConsumeLocked(const MacAddress& mac, std::string_view content_name,
+                           size_t wire_bytes, uint64_t now_ms);
+    void refill(TokenBucket& bucket, double rate, double burst, uint64_t now_ms);
+    std::string_view prefixOf(std::string_view content_name) const;
+    static uint64_t nowMs();
+
+    void updateSerialRateLocked();
+
+    AdmissionConfig config_;
+    int baudrate_;
+    double serialRate_;     // バイト/秒
+    double serialBurst_;
+
+    FixedSizeLRUCache<TokenBucket, kMaxMacBuckets, uint64_t> macBuckets_;
+    FixedSizeLRUCache<TokenBucket, kMaxPrefixBuckets> prefixBuckets_;
+    TokenBucket serialBucket_;
+
+    DeferredInterest deferred_[kMaxDeferred];
+    size_t deferredCount_;
+
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+template<typename Send>
+size_t AdmissionController::retryDeferred(Send&& send) {
+    // 許可されたものをロック中に取り出し、送信はロックを離してから行う
+    // （イベントループモードでは送信がUARTへの書き込みまで同期で行われる）
+    DeferredInterest ready[kMaxDeferred];
+    size_t ready_count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now_ms = nowMs();
+        size_t kept = 0;
+
+        for (size_t i = 0; i < deferredCount_; i++) {
+            DeferredInterest& entry = deferred_[i];
+
+            if (now_ms - entry.enqueuedMs >= config_.defer_timeout_ms) {
+                stats_.expired++;
+                continue;
+            }
+
+            std::string_view name(entry.name, entry.nameLen);
+            if (tryConsumeLocked(entry.mac, name, entry.wireBytes, now_ms) == Limit::None) {
+                ready[ready_count++] = entry;
+                continue;
+            }
+
+            // 送れなかったものは順序を保ったまま前へ詰める
+            if (kept != i) {
+                deferred_[kept] = entry;
+            }
+            kept++;
+        }
+        deferredCount_ = kept;
+    }
+
+    size_t sent = 0;
+    for (size_t i = 0; i < ready_count; i++) {
+        if (send(ready[i].mac, ready[i].frame, static_cast<size_t>(ready[i].frameLen))) {
+            sent++;
+        }
+    }
+
+    if (ready_count > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.retried += sent;
+        stats_.dropped_send += ready_count - sent;
+    }
+    return sent;
+}
@@ -5,6 +5,14 @@
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <algorithm>
+#include <random>
+#include "realtime.h"
+#include "publish_backlog.h"
 #include <cefore/cef_client.h>
 #include <cefore/cef_frame.h>
 
@@ -17,26 +25,166 @@ public:
     bool connect();
     void disconnect();
 
+    // 接続の死活を確認し、切断中なら指数バックオフで再接続を試みる（周期処理から呼ぶ）
+    // 受信用の接続を張り直した場合trueを返す（socketFd()が変わる）
+    bool maintainConnection();
+    bool isConnected() const { return connected_.load(std::memory_order_relaxed); }
+
+    // 切断中に公開できなかったContent Objectを保持する（connect()前に設定すること）
+    void enableBacklog(const BacklogConfig& config);
+    // 全接続が健全ならバックログから設定件数だけ再公開し、件数を返す（周期処理から呼ぶ）
+    size_t drainBacklog();
+    void reportBacklog(std::ostream& os) const;
+
+    // 最終チャンク番号を付けない（分割しない）公開
+    static constexpr uint32_t kNoEndChunk = UINT32_MAX;
+
     // Dataパケット送信（Content Object公開）
+    // 公開スレッドが動いていればキューに積んで即座に戻る（名前ごとの順序は保たれる）
+    // cefnetdとの接続が切れている場合はバックログに積み、再接続後に再公開する
+    // 分割したContent Objectではend_chunk_numに最終チャンク番号を指定する
     bool publishData(const std::string& uri,
                      const std::vector<uint8_t>& payload,
                      uint32_t chunk_num = 0,
                      uint32_t cache_time_sec = 300,
-                     uint32_t expiry_sec = 3600);
+                     uint32_t expiry_sec = 3600,
+                     uint32_t end_chunk_num = kNoEndChunk);
+    bool publishData(const std::string& uri,
+                     const uint8_t* payload,
+                     size_t payload_len,
+                     uint32_t chunk_num = 0,
+                     uint32_t cache_time_sec = 300,
+                     uint32_t expiry_sec = 3600,
+                     uint32_t end_chunk_num = kNoEndChunk);
+
+    // 公開専用のcefnetd接続をcount本張り、それぞれに公開スレッドを開始
+    // 名前（末尾のタイムスタンプを除いたURI）のハッシュで接続を選ぶ
+    // Interest受信はhandle_のまま（公開と接続を共有しない）
+    bool startPublishers(size_t count);
+    // キューに残った公開を処理してから停止し、接続を閉じる
+    void stopPublishers();
+    // 接続ごとの公開統計を出力
+    void reportPublishers(std::ostream& os) const;
 
     // Interest受信スレッド開始・停止
     void startReceiving();
     void stopReceiving();
 
+    // イベントループモード用: cefnetdとの接続ソケット（取得できなければ-1）
+    int socketFd() const { return socket_fd_; }
+    // ソケットが読み込み可能になったとき（またはポーリング周期ごと）に呼ぶ
+    void handleReadable();
+
     // Interest受信コールバック設定
     void setInterestCallback(std::function<void(const std::string& uri, uint32_t chunk_num)> callback);
 
+    // startReceiving()前に設定すること
+    void setRealtimeConfig(const RealtimeConfig& config) { realtime_ = config; }
+    const JitterProbe& rxJitter() const { return rx_jitter_; }
+
+    // 公開キュー1スロットに入るURI・ペイロードの上限
+    static constexpr size_t kMaxQueuedUriSize = 256;
+    static constexpr size_t kMaxQueuedPayload = 4096;
+    static constexpr size_t kPublishQueueSize = 16;
+
 private:
+    enum class PublishResult {
+        Ok,
+        Invalid,            // 名前・ペイロードが不正（再送しても無駄）
+        ConnectionLost,     // cefnetdへの書き込み失敗
+    };
+
+    // 再接続間隔（失敗ごとに倍、±25%の揺らぎで複数接続の同時再接続を避ける）
+    struct ReconnectBackoff {
+        static constexpr uint32_t kInitialMs = 100;
+        static constexpr uint32_t kMaxMs = 30000;
+
+        uint32_t delayMs = 0;
+        uint64_t nextAttemptMs = 0;
+        std::minstd_rand rng{std::random_device{}()};
+
+        void reset() { delayMs = 0; nextAttemptMs = 0; }
+        void failed(uint64_t now_ms) {
+            delayMs = delayMs == 0 ? kInitialMs : std::min<uint32_t>(delayMs * 2, kMaxMs);
+            nextAttemptMs = now_ms + delayMs * 3 / 4 + rng() % (delayMs / 2 + 1);
+        }
+        bool due(uint64_t now_ms) const { return now_ms >= nextAttemptMs; }
+        uint64_t remainingMs(uint64_t now_ms) const { return due(now_ms) ? 0 : nextAttemptMs - now_ms; }
+    };
+
+    struct PublishSlot {
+        uint32_t chunkNum;
+        uint32_t endChunkNum;
+        uint32_t cacheTimeSec;
+        uint32_t expirySec;
+        uint32_t traceId;
+        size_t payloadLen;
+        char uri[kMaxQueuedUriSize];
+        uint8_t payload[kMaxQueuedPayload];
+    };
+
+    // 公開専用の接続とスレッド
+    struct Publisher {
+        std::atomic<CefT_Client_Handle> handle{-1};    // 公開スレッドが張り直し、統計出力が読む
+        std::thread thread;
+        bool running = false;
+        std::atomic<bool> connected{false};
+        ReconnectBackoff backoff;   // 公開スレッドのみが触る
+        PublishSlot queue[kPublishQueueSize];
+        size_t head = 0;
+        size_t count = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        std::atomic<uint64_t> published{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<uint64_t> dropped{0};   // キュー満杯
+        std::atomic<uint64_t> refused{0};   // キュー満杯でバックログの再公開を断った（バックログに残る）
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> reconnects{0};
+    };
+
     void receiveLoop();
+    bool readOnce(unsigned char* buffer, size_t size);
+    void publishLoop(Publisher& publisher);
+    void reconnectPublisher(Publisher& publisher);
+    // from_backlog: キュー満杯でも破棄にならない（バックログの先頭に残って再試行される）
+    bool enqueuePublish(const std::string& uri, const uint8_t* payload, size_t payload_len,
+                        uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                        uint32_t end_chunk_num, bool from_backlog);
+    PublishResult publishOnMain(const std::string& uri, const uint8_t* payload, size_t payload_len,
+                                uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                                uint32_t end_chunk_num);
+    PublishResult publishOn(CefT_Client_Handle handle, const char* uri,
+                            const uint8_t* payload, size_t payload_len,
+                            uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                            uint32_t end_chunk_num);
+    bool deferPublish(std::string_view uri, const uint8_t* payload, size_t payload_len,
+                      uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                      uint32_t end_chunk_num);
+    // cef_client_connect()を呼び、新しく開いたソケットfdをsocket_fdに返す
+    CefT_Client_Handle connectHandle(int* socket_fd);
+    void markDisconnected();
+    // handle_を閉じて世代を進める（受信スレッドが読み込み中なら読み終えたそのスレッドが閉じる）
+    void retireHandleLocked();
     uint64_t getCurrentTimeMs();
 
     CefT_Client_Handle handle_;
+    int socket_fd_;
+    std::mutex handle_mutex_;       // handle_の使用と張り直しを排他（読み込み中は保持しない）
+    uint64_t handle_generation_;    // handle_を張り直すたびに増やす
+    CefT_Client_Handle reading_handle_;     // 読み込み中のハンドル（なければ-1）
+    CefT_Client_Handle retired_handle_;     // 読み込み後に閉じるハンドル
+    std::mutex connect_mutex_;      // 接続前後のソケットfd比較が他の接続と混ざらないように
+    std::atomic<bool> connected_;
+    ReconnectBackoff backoff_;      // 周期処理スレッドのみが触る
+    std::atomic<uint64_t> reconnects_;
+    std::unique_ptr<PublishBacklog> backlog_;
     std::thread recv_thread_;
     std::atomic<bool> running_;
     std::function<void(const std::string&, uint32_t)> interest_callback_;
+    RealtimeConfig realtime_;
+    unsigned char event_buff_[CefC_Max_Length];   // イベントループモードの受信バッファ
+    JitterProbe rx_jitter_;
+    std::vector<std::unique_ptr<Publisher>> publishers_;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 実行中の状態確認・調整用のUnixドメイン制御ソケット
+// 1行1コマンドのテキストで、応答は出力の後に "OK" または "ERR" の1行で終わる
+//   $ echo "fib /sensor" | socat - UNIX-CONNECT:/tmp/gateway-<pid>.sock
+// 受け付けとコマンド実行は周期処理から呼ぶpoll()の中だけで行う（専用スレッドなし）
+// そのためハンドラはメインスレッドの周期処理と同じスレッドで動く
+class ControlServer {
+public:
+    using Args = std::vector<std::string_view>;
+    // 出力をoutに書き、成功ならtrue（falseならoutの内容をエラーとして返す）
+    using Handler = std::function<bool(const Args& args, std::ostream& out)>;
+
+    static constexpr size_t kMaxClients = 4;
+    static constexpr size_t kMaxLineSize = 256;
+
+    explicit ControlServer(const std::string& path);
+    ~ControlServer();
+
+    // ソケットを作成してlistenする（古いソケットファイルは置き換える）
+    bool open();
+    const std::string& path() const { return path_; }
+
+    // usageはhelpで表示する引数の説明
+    void addCommand(const std::string& name, const std::string& usage, Handler handler);
+
+    // 新しい接続を受け付け、届いているコマンドを実行して応答する（ブロックしない）
+    void poll();
+
+private:
+    struct Command {
+        std::string usage;
+        Handler handler;
+    };
+
+    struct Client {
+        int fd = -1;
+        size_t len = 0;
+        char line[kMaxLineSize];
+    };
+
+    void acceptClients();
+    // 接続を閉じるべきならfalse
+    bool serviceClient(Client& client);
+    bool execute(std::string_view line, std::string& reply);
+    void closeClient(Client& client);
+
+    std::string path_;
+    int listen_fd_;
+    std::map<std::string, Command> commands_;
+    Client clients_[kMaxClients];
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// カウンティングBloomフィルタ（8bit飽和カウンタ）
+// 64bitハッシュを2つの32bit値に分け、ダブルハッシングでHashCount箇所を決める
+// 飽和したカウンタは減算しない（偽陰性を起こさないため）
+template<size_t CounterCount, size_t HashCount = 4>
+class CountingBloomFilter {
+public:
+    static_assert((CounterCount & (CounterCount - 1)) == 0, "CounterCount must be a power of two");
+
+    CountingBloomFilter() { clear(); }
+
+    void add(uint64_t hash) {
+        for (size_t i = 0; i < HashCount; i++) {
+            uint8_t& counter = counters_[index(hash, i)];
+            if (counter != kSaturated) {
+                counter++;
+            }
+        }
+    }
+
+    void remove(uint64_t hash) {
+        for (size_t i = 0; i < HashCount; i++) {
+            uint8_t& counter = counters_[index(hash, i)];
+            if (counter != 0 && counter != kSaturated) {
+                counter--;
+            }
+        }
+    }
+
+    bool mightContain(uint64_t hash) const {
+        for (size_t i = 0; i < HashCount; i++) {
+            if (counters_[index(hash, i)] == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear() {
+        for (auto& counter : counters_) {
+            counter = 0;
+        }
+    }
+
+private:
+    static constexpr uint8_t kSaturated = 0xFF;
+
+    static size_t index(uint64_t hash, size_t i) {
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+        return (h1 + i * h2) & (CounterCount - 1);
+    }
+
+    uint8_t counters_[CounterCount];
+};
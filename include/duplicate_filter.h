@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include "mac_address.h"
+
+// メッシュで複数経路から届いた同一DATAの抑制
+// (コンテンツ名, 内容)のハッシュを時間窓付きの固定長ハッシュ表に記録し、
+// 窓内に再び届いたものを重複として扱う
+// 重複のうちホップ数がより小さい経路から届いたものはFIB学習にだけ使い、それまでの送信元と置き換える
+// check()はUART受信スレッドからのみ呼ぶこと（ロックなし）
+class DuplicateFilter {
+public:
+    static constexpr size_t kTableSize = 512;   // 2のべき乗
+    static constexpr size_t kMaxProbe = 8;
+
+    enum class Result {
+        First,          // 初めて見た → 学習・公開する
+        BetterPath,     // 重複だがより近い経路 → 学習のみ
+        Duplicate,      // 重複 → 破棄
+    };
+
+    // 書き込みはUART受信スレッドのみ、statsコマンド（周期処理）から読むためatomic
+    struct Stats {
+        std::atomic<uint64_t> passed{0};
+        std::atomic<uint64_t> better_path{0};
+        std::atomic<uint64_t> suppressed{0};
+        std::atomic<uint64_t> evicted{0};       // 窓内のエントリを表の溢れで上書きした回数
+    };
+
+    explicit DuplicateFilter(uint32_t window_ms = 2000);
+
+    // BetterPathの場合、previous_macにそれまでの（より遠い）送信元を返す
+    Result check(std::string_view content_name, const uint8_t* content, size_t len,
+                 uint8_t hop_count, const MacAddress& sender_mac,
+                 MacAddress* previous_mac = nullptr);
+
+    const Stats& stats() const { return stats_; }
+    void report(std::ostream& os) const;
+
+private:
+    struct Entry {
+        uint64_t key = 0;       // 0: 空
+        uint64_t firstSeenMs = 0;
+        uint8_t bestHop = 0;
+        MacAddress bestMac;
+    };
+
+    Result checkAt(uint64_t key, uint8_t hop_count, const MacAddress& sender_mac, uint64_t now_ms,
+                   MacAddress* previous_mac);
+    static uint64_t nowMs();
+
+    Entry table_[kTableSize];
+    uint32_t windowMs_;
+    Stats stats_;
+};
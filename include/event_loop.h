@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include <signal.h>
+
+// 単一スレッドのepollイベントループ
+// fd・周期タイマー(timerfd)・シグナル(signalfd)を同じループで多重化する
+class EventLoop {
+public:
+    using Handler = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    bool init();
+
+    // fdが読み込み可能になったらhandlerを呼ぶ
+    bool addFd(int fd, Handler handler);
+    void removeFd(int fd);
+
+    // interval_msごとにhandlerを呼ぶ
+    bool addTimer(uint32_t interval_ms, Handler handler);
+
+    // signalsを受信したらhandler(signo)を呼ぶ（signalsは事前にブロックしておくこと）
+    bool addSignals(const sigset_t& signals, std::function<void(int)> handler);
+
+    // stop()が呼ばれるまでイベントを処理
+    void run();
+    void stop() { running_ = false; }
+
+private:
+    bool watch(int fd, Handler handler, bool owned);
+
+    int epoll_fd_;
+    bool running_;
+    std::map<int, Handler> handlers_;
+    std::vector<int> owned_fds_;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <netinet/in.h>
+#include "mac_address.h"
+#include "gateway_fib.h"
+
+// FIB複製の設定（既定は無効）
+struct ReplicationConfig {
+    bool enabled = false;
+    uint16_t port = 5790;
+    std::string group = "239.255.77.1";     // peersが空ならこのグループへマルチキャスト
+    std::vector<std::string> peers;         // "IPv4:port"（指定時は各ピアへユニキャスト）
+    uint32_t sync_interval_ms = 2000;       // ダイジェスト（反エントロピー）の送信周期
+};
+
+// 同じサイトに置いた複数ゲートウェイ間でFIBの学習結果を複製する
+// - ローカルで経路が増えたとき（新しい名前・別経路のMAC）だけ、その差分をUDPで即座に送る
+// - 各ノードは送信元ノードごとに連続して適用済みの更新番号（バージョンベクタ）を持ち、
+//   周期的にダイジェストとして広告する。相手が自分の更新を取りこぼしていれば
+//   履歴から再送し、履歴より古ければFIB全体（スナップショット）を送る（全データグラムが揃うまで番号を進めない）
+// 受信した経路はFIBに学習するだけで他のノードへは中継しない（全ノードが直接届く前提）
+class FibReplicator {
+public:
+    static constexpr size_t kMaxNodes = 8;
+    static constexpr size_t kLogSize = 256;         // 再送用に保持する自分の更新数
+    static constexpr size_t kMaxNameSize = 128;
+    static constexpr size_t kMaxDatagram = 1200;
+    static constexpr uint64_t kNodeTimeoutMs = 60 * 1000;
+    static constexpr size_t kMaxSnapshotParts = 256;    // スナップショット1回のデータグラム数の上限
+
+    struct Stats {
+        uint64_t announced = 0;     // 送った自分の更新
+        uint64_t applied = 0;       // FIBに学習した他ノードの経路
+        uint64_t gaps = 0;          // 更新番号の抜けを検出
+        uint64_t resent = 0;        // 履歴から再送した更新
+        uint64_t snapshots = 0;     // FIB全体を送った回数
+        uint64_t rejected = 0;      // 形式不正のデータグラム
+    };
+
+    FibReplicator(GatewayFIB& fib, const ReplicationConfig& config);
+    ~FibReplicator();
+
+    // ソケットを開いてbindし、マルチキャストならグループに参加する
+    bool open();
+
+    // スレッドモード: 受信スレッドを開始・停止
+    void start();
+    void stop();
+
+    // イベントループモード: fdが読み込み可能になったときに呼ぶ
+    int fd() const { return fd_; }
+    void handleReadable();
+
+    // ローカルの学習で経路が増えたとき（Created/Merged）に呼ぶ
+    void announce(std::string_view content_name, const MacAddress& mac);
+
+    // 周期処理から呼ぶ: 周期が来ていればダイジェストを送り、応答のないノードを忘れる
+    void tick(uint64_t now_ms);
+
+    uint32_t nodeId() const { return node_id_; }
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    struct Node {
+        uint32_t id = 0;            // 0: 空き
+        uint32_t applied = 0;       // このノードの更新を連続して適用済みの番号
+        uint64_t lastHeardMs = 0;
+        uint64_t lastPullMs = 0;    // 抜けを検出してダイジェストを返した時刻
+        uint32_t snapshotSeq = 0;   // 受信中のスナップショットの番号
+        uint16_t snapshotTotal = 0; // 最後のデータグラムで分かる総数（0: 未着）
+        std::bitset<kMaxSnapshotParts> snapshotParts;  // 届いたデータグラム
+        sockaddr_in addr{};
+    };
+
+    struct LogEntry {
+        uint32_t seq = 0;
+        MacAddress mac;
+        uint8_t nameLen = 0;
+        char name[kMaxNameSize];
+    };
+
+    struct Route {
+        std::string name;
+        MacAddress mac;
+    };
+
+    void receiveLoop();
+    void handleDatagram(const uint8_t* data, size_t len, const sockaddr_in& from);
+    void applyRoutes(const uint8_t* data, size_t len, uint8_t type, uint32_t origin,
+                     uint32_t seq, uint16_t count, uint8_t flags, uint8_t part,
+                     const sockaddr_in& from);
+    void applyDigest(const uint8_t* data, size_t len, uint32_t origin, uint32_t seq,
+                     uint16_t count, const sockaddr_in& from);
+    Node* touchNode(uint32_t id, const sockaddr_in& from, uint64_t now_ms);
+    void sendDigest(const sockaddr_in* to);
+    void resend(const sockaddr_in& to, uint32_t from_seq);
+    void sendSnapshot(const sockaddr_in& to);
+    void sendTo(const uint8_t* data, size_t len, const sockaddr_in* to);
+    static bool parseAddress(const std::string& text, uint16_t default_port, sockaddr_in& out);
+    static uint64_t nowMs();
+
+    GatewayFIB& fib_;
+    ReplicationConfig config_;
+    uint32_t node_id_;
+    int fd_;
+    bool multicast_;
+    std::vector<sockaddr_in> destinations_;
+    std::thread recv_thread_;
+    std::atomic<bool> running_;
+
+    mutable std::mutex mutex_;      // 以下を保護
+    uint32_t seq_;                  // 自分の最新の更新番号
+    LogEntry log_[kLogSize];        // seq % kLogSize に格納
+    Node nodes_[kMaxNodes];
+    uint64_t last_digest_ms_;
+    Stats stats_;
+};
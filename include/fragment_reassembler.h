@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "icsn_packet.h"
+#include "mac_address.h"
+
+// FRAGフレームを元のメッセージに再構築する
+// バッファは固定数のスロットで管理し、タイムアウトまたは枯渇時に古いものから破棄する
+class FragmentReassembler {
+public:
+    static constexpr size_t kMaxMessages = 8;
+    static constexpr size_t kMaxFragments = 16;
+    static constexpr size_t kMaxMessageSize = kMaxFragments * IcsnPacketView::kMaxFragmentData;
+
+    // 書き込みはUART受信スレッドのみ、statsコマンド（周期処理）から読むためatomic
+    struct Stats {
+        std::atomic<uint64_t> completed{0};    // 再構築完了
+        std::atomic<uint64_t> timed_out{0};    // タイムアウトで破棄
+        std::atomic<uint64_t> evicted{0};      // スロット不足で破棄
+        std::atomic<uint64_t> rejected{0};     // 不正なフラグメント
+        std::atomic<uint64_t> duplicates{0};   // 受信済みフラグメントの再送
+        std::atomic<uint64_t> mismatched{0};   // 同じメッセージIDで名前の異なるフラグメント（スロットごと破棄）
+    };
+
+    explicit FragmentReassembler(uint32_t timeout_ms = 2000);
+
+    // フラグメント追加
+    // メッセージが揃った場合trueを返し、content_nameとpayloadに結果を格納
+    // （呼び出し側がバッファを使い回せば、容量確保後はヒープ確保しない）
+    bool addFragment(const MacAddress& sender_mac,
+                     const IcsnPacketView& fragment,
+                     std::string& content_name,
+                     std::vector<uint8_t>& payload);
+
+    // タイムアウトしたスロットを解放（解放数を返す）
+    size_t expire();
+
+    const Stats& stats() const { return stats_; }
+    void report(std::ostream& os) const;
+
+private:
+    struct Slot {
+        bool inUse;
+        MacAddress senderMac;
+        uint16_t messageId;
+        uint8_t fragmentCount;
+        uint8_t receivedCount;
+        uint32_t receivedMask;
+        uint64_t lastUpdateMs;
+        uint8_t nameLen;
+        char name[sizeof(CommunicationData::contentName)];    // 最初に届いたフラグメントの名前
+        uint8_t fragmentLen[kMaxFragments];
+        uint8_t data[kMaxMessageSize];
+
+        Slot() : inUse(false), messageId(0), fragmentCount(0),
+                 receivedCount(0), receivedMask(0), lastUpdateMs(0), nameLen(0) {}
+
+        std::string_view nameView() const { return std::string_view(name, nameLen); }
+    };
+
+    Slot* findSlot(const MacAddress& sender_mac, uint16_t message_id);
+    Slot* allocateSlot();
+    size_t expireAt(uint64_t now_ms);
+    uint64_t getCurrentTimeMs();
+
+    Slot slots_[kMaxMessages];
+    uint32_t timeoutMs_;
+    Stats stats_;
+};
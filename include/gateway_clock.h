@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// パケット処理の時刻判定（重複抑制の窓、FIB学習の更新間隔、フラグメント再構築の期限、
+// 流量制御のトークン補充、周期処理）に使う時計
+// 通常は単調時計を返す。--replay中は記録時刻から作った再生時刻を返し、
+// 再生速度や実行環境に関わらず同じキャプチャから同じ判定結果になるようにする
+class GatewayClock {
+public:
+    static uint64_t nowMs() {
+        if (replaying_.load(std::memory_order_acquire)) {
+            return replayMs_.load(std::memory_order_relaxed);
+        }
+        return monotonicMs();
+    }
+
+    static uint64_t monotonicMs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    }
+
+    // 以降のnowMs()はnow_msを返す（再生中に進めるのは再生スレッドだけ）
+    static void setReplayMs(uint64_t now_ms) {
+        replayMs_.store(now_ms, std::memory_order_relaxed);
+        replaying_.store(true, std::memory_order_release);
+    }
+
+    // 単調時計に戻す
+    static void stopReplay() { replaying_.store(false, std::memory_order_release); }
+
+private:
+    static inline std::atomic<bool> replaying_{false};
+    static inline std::atomic<uint64_t> replayMs_{0};
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include "realtime.h"
+#include "admission_controller.h"
+#include "publish_backlog.h"
+#include "fib_replicator.h"
+#include "gateway_log.h"
+#include "segment_store.h"
+
+// 人気Interestの先読み設定（既定は無効）
+struct PrefetchConfig {
+    bool enabled = false;
+    uint32_t interval_ms = 5000;  // 先読み周期（周期ごとに人気度を半減）
+    size_t top_k = 8;             // 追跡する上位名数
+    uint32_t budget = 4;          // 1周期あたりに送る先読みInterestの上限
+    uint32_t min_requests = 3;    // 直近でこの回数以上要求された名前だけ先読み
+};
+
+// センサー値履歴の設定（既定は無効）
+struct HistoryConfig {
+    bool enabled = false;
+    std::string path;           // 空なら匿名メモリ（再起動で消える）
+};
+
+// キャプチャの再生設定（pathが空なら通常動作）
+struct ReplayConfig {
+    std::string path;
+    uint32_t speed = 1;         // 記録時の何倍速で流すか（0: 待たずに最速）
+};
+
+// ゲートウェイ起動設定（コマンドライン引数から構築）
+struct GatewayConfig {
+    std::string uart_device = "/dev/serial0";
+    int baudrate = 115200;          // 標準外の値（1500000など）も可
+    bool rtscts = false;            // RTS/CTSハードウェアフロー制御
+    uint32_t serial_test_sec = 0;   // 0以外ならループバックでリンク試験だけ行って終了
+    bool event_loop = false;    // 単一スレッドのepollイベントループで動作
+    int fib_aggregate_depth = 0;    // FIB学習をこの深さのプレフィックスにまとめる（0: 名前そのまま）
+    uint32_t dedup_window_ms = 0;   // 重複DATA抑制の時間窓（0: 無効）
+    uint32_t cache_time_sec = 300;  // 公開するContent Objectのキャッシュ時間（制御ソケットで変更可）
+    uint32_t expiry_sec = 3600;     // 公開するContent Objectの有効期限
+    size_t publishers = 0;      // 公開専用のcefnetd接続数（0: 受信と同じ接続で同期的に公開）
+    bool trace = false;         // パケット単位のトレースを記録（SIGUSR1でダンプ）
+    std::string trace_path;     // 空なら /tmp/gateway-trace-<pid>.json
+    std::string capture_path;   // 空でなければUARTの受信・送信行をこのファイルへ記録
+    bool control = false;       // 制御ソケットを開く
+    std::string control_path;   // 空なら /tmp/gateway-<pid>.sock
+    LogLevel log_level = LogLevel::Info;
+    RealtimeConfig realtime;
+    PrefetchConfig prefetch;
+    AdmissionConfig admission;
+    HistoryConfig history;
+    BacklogConfig backlog;      // capacity=0でバックログなし（切断中の公開は失敗）
+    ReplicationConfig replication;
+    SegmentConfig segment;
+    ReplayConfig replay;        // 指定時はUARTを開かずキャプチャを流し込んで終了する
+};
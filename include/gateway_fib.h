@@ -1,39 +1,141 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <set>
+#include <mutex>
+#include <ostream>
 #include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+#include "counting_bloom_filter.h"
+#include "mac_address.h"
 
 class GatewayFIB {
 public:
-    GatewayFIB(int max_virtual_depth = 3);
+    // 否定キャッシュ（Bloomフィルタ）の統計
+    struct FilterStats {
+        uint64_t rejected = 0;         // フィルタで即座に棄却（経路なし確定）
+        uint64_t passed = 0;           // フィルタを通過してLPMを実行
+        uint64_t falsePositives = 0;   // 通過したがLPMで見つからなかった
+    };
+
+    // learn()の結果
+    enum class LearnResult {
+        Created,        // 新しい経路
+        Merged,         // 既存の経路に別のMACを追加
+        Refreshed,      // 既知のMACの鮮度を更新
+        Skipped,        // 直近に学習済み
+    };
+
+    // 学習の統計
+    struct LearnStats {
+        uint64_t created = 0;      // 新しいエントリ
+        uint64_t merged = 0;       // 既存エントリに別経路のMACを追加
+        uint64_t refreshed = 0;    // 既知のMACの鮮度を更新
+        uint64_t skipped = 0;      // 直近に更新済みのため何もしなかった
+    };
 
-    // FIBエントリ登録
-    void save(const std::string& content_name, const std::set<std::string>& mac_addresses);
+    // aggregate_depth > 0 の場合、learn()はその深さのプレフィックスにまとめて登録する
+    // （/sensor/room1/temp と /sensor/room1/humid → /sensor/room1）
+    GatewayFIB(int max_virtual_depth = 3, int aggregate_depth = 0);
+
+    // FIBエントリ登録（既存のMACを置き換える）
+    void save(std::string_view content_name, const std::set<std::string>& mac_addresses);
+
+    // DATA受信時の経路学習: 既存エントリにMACをマージし、MACごとの最終受信時刻を更新する
+    // 同じMACを直近（kRefreshIntervalMs以内）に学習済みならエントリにもLRU順序にも触れない
+    // learned_nameには実際に登録した名前（正規化・集約後）を返す
+    LearnResult learn(std::string_view content_name, const MacAddress& mac,
+                      std::string* learned_name = nullptr);
+
+    // 同じDATAがより近い経路から届いたとき: 同じエントリからworse_macを外してmacを学習する
+    // （遠い経路へのInterestの重複送信をやめる。集約時は同じプレフィックスの他の名前も近い経路に寄せる）
+    LearnResult replace(std::string_view content_name, const MacAddress& worse_mac, const MacAddress& mac,
+                        std::string* learned_name = nullptr);
 
     // 最長一致検索（TwoStageアルゴリズムによるLPM）
-    std::set<std::string> lookup(const std::string& content_name);
+    // rejected_by_filterには否定キャッシュで棄却されたかを返す
+    std::set<std::string> lookup(std::string_view content_name, bool* rejected_by_filter = nullptr);
 
     // エントリ削除
-    void remove(const std::string& content_name);
+    void remove(std::string_view content_name);
 
     // 存在確認
-    bool find(const std::string& content_name);
+    bool find(std::string_view content_name);
+
+    // 全経路をfn(name, mac)で走査（次ホップごとに1回、新しいエントリ順、LRU順序は変えない）
+    // ロックを保持したまま呼ぶため、fnからFIBを操作しないこと
+    template<typename Fn>
+    void forEachRoute(Fn&& fn) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cache_.forEach([&fn](std::string_view name, const FIBEntry& entry) {
+            for (uint8_t i = 0; i < entry.nextHopCount; i++) {
+                fn(name, entry.nextHops[i].mac);
+            }
+        });
+    }
+
+    // エントリ一覧（新しい順、名前・次ホップ・最終受信からの経過時間）を出力
+    // prefixを指定した場合はそれで始まる名前のみ（LRU順序は変えない）
+    void dump(std::ostream& os, std::string_view prefix = std::string_view()) const;
+    size_t size() const;
+
+    FilterStats filterStats() const;
+    LearnStats learnStats() const;
+
+    // 否定キャッシュを検索に使うか（無効にしてもフィルタ自体は更新し続ける、比較計測用）
+    void setFilterEnabled(bool enabled);
+
+    // 保持できるエントリ数（超えると最も長く使われていないものを追い出す）
+    static constexpr size_t kCapacity = 100;
+
+    // 1エントリが保持する次ホップ数（満杯時は最も古いMACを置き換える）
+    static constexpr size_t kMaxNextHops = 4;
+    // 同じMACの再学習をまとめる間隔
+    static constexpr uint64_t kRefreshIntervalMs = 1000;
+    // 最も新しい次ホップよりこれ以上古いMACは検索結果に含めない
+    static constexpr uint64_t kRouteLifetimeMs = 10 * 60 * 1000;
 
 private:
+    // フィルタで扱う最大深度（これより深い名前はフィルタを使わずLPMする）
+    static constexpr int kMaxFilterDepth = 16;
+
+    struct NextHop {
+        MacAddress mac;
+        uint64_t lastSeenMs;
+    };
+
     struct FIBEntry {
         bool isVirtual;
         int maximumDepth;
-        std::set<std::string> macAddresses;
+        uint8_t nextHopCount;
+        NextHop nextHops[kMaxNextHops];
 
-        FIBEntry() : isVirtual(false), maximumDepth(0) {}
+        FIBEntry() : isVirtual(false), maximumDepth(0), nextHopCount(0) {}
     };
 
-    FixedSizeLRUCache<FIBEntry, 100> cache_;
+    FixedSizeLRUCache<FIBEntry, kCapacity> cache_;
     int maxVirtualDepth_;
+    int aggregateDepth_;
+    LearnStats learnStats_;
+
+    // FIBに存在するキー（プレフィックス）の集合。save/remove/追い出しと同期する
+    CountingBloomFilter<2048> filter_;
+    bool filterEnabled_;
+    FilterStats filterStats_;
+    mutable std::mutex mutex_;
 
-    std::string extractPrefix(const std::string& name, int prefixDepth) const;
-    bool lookupEntry(const std::string& name, int prefixDepth, FIBEntry& outEntry);
-    bool fibLpmLookup(const std::string& name, int nameDepth, int maxVirtualDepth, FIBEntry& outEntry);
-    int calculateDepth(const std::string& name) const;
+    void putEntry(std::string_view name, const FIBEntry& entry);
+    std::string_view routeName(std::string_view content_name, std::string& normalized) const;
+    LearnResult learnLocked(std::string_view name, const MacAddress& mac, uint64_t now_ms);
+    static std::set<std::string> nextHopSet(const FIBEntry& entry);
+    static uint64_t nowMs();
+    std::string_view extractPrefix(std::string_view name, int prefixDepth) const;
+    const FIBEntry* lookupEntry(std::string_view name, int prefixDepth);
+    const FIBEntry* fibLpmLookup(std::string_view name, int nameDepth, int maxVirtualDepth);
+    int calculateDepth(std::string_view name) const;
+    bool mayHaveRoute(std::string_view name, int nameDepth) const;
+    static uint64_t filterHash(std::string_view name);
+    static int prefixHashes(std::string_view name, uint64_t* out, int maxDepth);
+    static bool isCanonical(std::string_view name);
+    static std::string canonicalize(std::string_view name);
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <string_view>
+
+// ログの詳細度（実行中に制御ソケットから変更できる）
+enum class LogLevel : int {
+    Error = 0,      // エラーのみ（パケットごとの通知を出さない）
+    Info = 1,       // パケットごとの受信・公開・転送（既定）
+    Debug = 2,      // FIB学習・重複抑制の詳細
+};
+
+class GatewayLog {
+public:
+    static void setLevel(LogLevel level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+    static LogLevel level() { return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
+    static bool enabled(LogLevel level) {
+        return static_cast<int>(level) <= level_.load(std::memory_order_relaxed);
+    }
+
+    static const char* toString(LogLevel level) {
+        switch (level) {
+        case LogLevel::Error: return "error";
+        case LogLevel::Info: return "info";
+        case LogLevel::Debug: return "debug";
+        }
+        return "unknown";
+    }
+
+    static bool parse(std::string_view text, LogLevel& out) {
+        for (LogLevel level : {LogLevel::Error, LogLevel::Info, LogLevel::Debug}) {
+            if (text == toString(level)) {
+                out = level;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static inline std::atomic<int> level_{static_cast<int>(LogLevel::Info)};
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// ICSNフレームのワイヤフォーマット定義
+//
+// バージョン0（レガシー）: バージョンバイトなし。先頭がASCIIのシグナルコード
+//   DATA/INTEREST: CommunicationData (131バイト固定)
+//   FRAG:          IcsnLegacyFragmentFrame (116バイト + データ)
+//
+// バージョン1以降: 先頭1バイトがバージョン番号 (0x01〜0x1F)
+//   [0] version  [1] signal  [2] hopCount  [3] nameLen
+//   DATA/INTEREST: [4] contentLen  [5..] name, content
+//   FRAG:          [4..5] messageId  [6] fragmentIndex  [7] fragmentCount
+//                  [8] dataLen  [9..] name, data
+//
+// レガシーフレームの先頭は印字可能文字なので、0x20未満のバイトでバージョンを判別する
+
+enum class IcsnSignal : uint8_t {
+    Unknown = 0,
+    Data = 1,
+    Interest = 2,
+    Fragment = 3,
+};
+
+inline const char* toString(IcsnSignal signal) {
+    switch (signal) {
+        case IcsnSignal::Data: return "DATA";
+        case IcsnSignal::Interest: return "INTEREST";
+        case IcsnSignal::Fragment: return "FRAG";
+        default: return "UNKNOWN";
+    }
+}
+
+// ESP32のCommunicationData構造体（packed）
+struct __attribute__((packed)) CommunicationData {
+    char signalCode[10];
+    uint8_t hopCount;
+    char contentName[100];
+    char content[20];
+};
+
+// レガシーのフラグメントフレーム（packed）
+// CommunicationDataと同じ先頭部を持ち、content以降をフラグメントヘッダとデータに置き換える
+struct __attribute__((packed)) IcsnLegacyFragmentFrame {
+    char signalCode[10];
+    uint8_t hopCount;
+    char contentName[100];
+    uint16_t messageId;
+    uint8_t fragmentIndex;
+    uint8_t fragmentCount;
+    uint8_t dataLen;
+    uint8_t data[134];
+};
+
+class IcsnPacketView {
+public:
+    // ESP-NOWフレームの最大長
+    static constexpr size_t kMaxFrameSize = 250;
+
+    static constexpr uint8_t kLegacyVersion = 0;
+    static constexpr uint8_t kCurrentVersion = 1;
+
+    static constexpr size_t kV1HeaderSize = 5;
+    static constexpr size_t kV1FragmentHeaderSize = 9;
+
+    // 1フラグメントで運べる最大データ長（名前1文字のv1フレーム）
+    static constexpr size_t kMaxFragmentData = kMaxFrameSize - kV1FragmentHeaderSize - 1;
+
+    // バッファを解析してビューを設定する（コピーしない）
+    // ビューはバッファが生きている間だけ有効
+    bool decode(const uint8_t* data, size_t len) {
+        *this = IcsnPacketView();
+
+        if (!data || len == 0 || len > kMaxFrameSize) {
+            return false;
+        }
+
+        if (data[0] >= 0x20) {
+            return decodeLegacy(data, len);
+        }
+
+        if (data[0] == 1) {
+            return decodeV1(data, len);
+        }
+
+        // 未対応のバージョン
+        return false;
+    }
+
+    uint8_t version() const { return version_; }
+    IcsnSignal signal() const { return signal_; }
+    uint8_t hopCount() const { return hopCount_; }
+    std::string_view contentName() const { return contentName_; }
+
+    // DATA/INTERESTではコンテンツ本体、FRAGではフラグメントデータ
+    std::string_view content() const { return content_; }
+    const uint8_t* contentData() const { return reinterpret_cast<const uint8_t*>(content_.data()); }
+
+    // FRAGのみ有効
+    uint16_t messageId() const { return messageId_; }
+    uint8_t fragmentIndex() const { return fragmentIndex_; }
+    uint8_t fragmentCount() const { return fragmentCount_; }
+
+private:
+    static std::string_view fixedField(const char* field, size_t size) {
+        return std::string_view(field, strnlen(field, size));
+    }
+
+    static IcsnSignal legacySignal(std::string_view code) {
+        if (code == "DATA") return IcsnSignal::Data;
+        if (code == "INTEREST") return IcsnSignal::Interest;
+        if (code == "FRAG") return IcsnSignal::Fragment;
+        return IcsnSignal::Unknown;
+    }
+
+    bool decodeLegacy(const uint8_t* data, size_t len) {
+        const char* text = reinterpret_cast<const char*>(data);
+        version_ = kLegacyVersion;
+        signal_ = legacySignal(fixedField(text, sizeof(CommunicationData::signalCode)));
+
+        if (signal_ == IcsnSignal::Fragment) {
+            // データ部は可変長（最終フラグメントは短くてよい）
+            const size_t header_size = offsetof(IcsnLegacyFragmentFrame, data);
+            if (len < header_size) {
+                return false;
+            }
+
+            IcsnLegacyFragmentFrame header;
+            memcpy(&header, data, header_size);
+            if (header.dataLen > len - header_size) {
+                return false;
+            }
+
+            hopCount_ = header.hopCount;
+            contentName_ = fixedField(text + offsetof(IcsnLegacyFragmentFrame, contentName),
+                                      sizeof(header.contentName));
+            content_ = std::string_view(text + header_size, header.dataLen);
+            return setFragment(header.messageId, header.fragmentIndex, header.fragmentCount);
+        }
+
+        if (len != sizeof(CommunicationData) || signal_ == IcsnSignal::Unknown) {
+            return false;
+        }
+
+        hopCount_ = data[offsetof(CommunicationData, hopCount)];
+        contentName_ = fixedField(text + offsetof(CommunicationData, contentName),
+                                  sizeof(CommunicationData::contentName));
+        content_ = fixedField(text + offsetof(CommunicationData, content),
+                              sizeof(CommunicationData::content));
+        return true;
+    }
+
+    bool decodeV1(const uint8_t* data, size_t len) {
+        if (len < kV1HeaderSize) {
+            return false;
+        }
+
+        const char* text = reinterpret_cast<const char*>(data);
+        version_ = data[0];
+        signal_ = static_cast<IcsnSignal>(data[1]);
+        hopCount_ = data[2];
+        size_t name_len = data[3];
+
+        if (signal_ == IcsnSignal::Fragment) {
+            if (len < kV1FragmentHeaderSize) {
+                return false;
+            }
+            size_t data_len = data[8];
+            if (kV1FragmentHeaderSize + name_len + data_len > len) {
+                return false;
+            }
+            contentName_ = std::string_view(text + kV1FragmentHeaderSize, name_len);
+            content_ = std::string_view(text + kV1FragmentHeaderSize + name_len, data_len);
+            uint16_t message_id = static_cast<uint16_t>(data[4] | (data[5] << 8));
+            return setFragment(message_id, data[6], data[7]);
+        }
+
+        if (signal_ != IcsnSignal::Data && signal_ != IcsnSignal::Interest) {
+            return false;
+        }
+
+        size_t content_len = data[4];
+        if (kV1HeaderSize + name_len + content_len > len) {
+            return false;
+        }
+        contentName_ = std::string_view(text + kV1HeaderSize, name_len);
+        content_ = std::string_view(text + kV1HeaderSize + name_len, content_len);
+        return true;
+    }
+
+    bool setFragment(uint16_t message_id, uint8_t index, uint8_t count) {
+        if (count == 0 || index >= count) {
+            return false;
+        }
+        messageId_ = message_id;
+        fragmentIndex_ = index;
+        fragmentCount_ = count;
+        return true;
+    }
+
+    uint8_t version_ = kLegacyVersion;
+    IcsnSignal signal_ = IcsnSignal::Unknown;
+    uint8_t hopCount_ = 0;
+    std::string_view contentName_;
+    std::string_view content_;
+    uint16_t messageId_ = 0;
+    uint8_t fragmentIndex_ = 0;
+    uint8_t fragmentCount_ = 0;
+};
+
+class IcsnFrameBuilder {
+public:
+    // 送信バッファ上にINTERESTフレームを直接構築し、フレーム長を返す（失敗時0）
+    static size_t buildInterest(uint8_t* buffer, size_t capacity,
+                                std::string_view content_name,
+                                uint8_t hop_count,
+                                uint8_t version = IcsnPacketView::kLegacyVersion) {
+        if (version == IcsnPacketView::kLegacyVersion) {
+            if (capacity < sizeof(CommunicationData) ||
+                content_name.size() >= sizeof(CommunicationData::contentName)) {
+                return 0;
+            }
+
+            memset(buffer, 0, sizeof(CommunicationData));
+            memcpy(buffer + offsetof(CommunicationData, signalCode), "INTEREST", 8);
+            buffer[offsetof(CommunicationData, hopCount)] = hop_count;
+            memcpy(buffer + offsetof(CommunicationData, contentName),
+                   content_name.data(), content_name.size());
+            memcpy(buffer + offsetof(CommunicationData, content), "N/A", 3);
+            return sizeof(CommunicationData);
+        }
+
+        if (version == 1) {
+            size_t frame_len = IcsnPacketView::kV1HeaderSize + content_name.size();
+            if (content_name.size() > UINT8_MAX || frame_len > capacity ||
+                frame_len > IcsnPacketView::kMaxFrameSize) {
+                return 0;
+            }
+
+            buffer[0] = version;
+            buffer[1] = static_cast<uint8_t>(IcsnSignal::Interest);
+            buffer[2] = hop_count;
+            buffer[3] = static_cast<uint8_t>(content_name.size());
+            buffer[4] = 0;
+            memcpy(buffer + IcsnPacketView::kV1HeaderSize, content_name.data(), content_name.size());
+            return frame_len;
+        }
+
+        return 0;
+    }
+};
+
+static_assert(sizeof(CommunicationData) == 131, "CommunicationData must match the ESP32 layout");
+static_assert(sizeof(IcsnLegacyFragmentFrame) == IcsnPacketView::kMaxFrameSize,
+              "IcsnLegacyFragmentFrame must fill exactly one ESP-NOW frame");
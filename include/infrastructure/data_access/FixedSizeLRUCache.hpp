@@ -1,61 +1,195 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
+
+// キャッシュ用ハッシュ関数
+// 文字列は8バイト単位で処理し、最後に64bitミキサーで拡散する
+struct CacheKeyHasher {
+    uint64_t operator()(std::string_view key) const noexcept {
+        const uint64_t m = 0x9E3779B97F4A7C15ULL;
+        uint64_t h = key.size() * m;
+        const char* p = key.data();
+        size_t n = key.size();
+
+        while (n >= 8) {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            h = (h ^ w) * m;
+            h ^= h >> 29;
+            p += 8;
+            n -= 8;
+        }
+        if (n > 0) {
+            uint64_t w = 0;
+            memcpy(&w, p, n);
+            h = (h ^ w) * m;
+            h ^= h >> 29;
+        }
+        return mix(h);
+    }
+
+    template<typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    uint64_t operator()(T key) const noexcept {
+        return mix(static_cast<uint64_t>(key));
+    }
+
+    static uint64_t mix(uint64_t h) noexcept {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// キーの保持方法（既定: 値をそのまま保持）
+template<typename KeyType, size_t InlineSize>
+struct CacheKeyStorage {
+    using LookupType = const KeyType&;
+
+    KeyType key{};
+
+    void assign(LookupType k) { key = k; }
+    bool equals(LookupType k) const { return key == k; }
+    const KeyType& get() const { return key; }
+    void clear() { key = KeyType{}; }
+};
+
+// 文字列キー: 短いキーはエントリ内にインライン保持し、長いものだけヒープを使う
+// 検索はstd::string_viewで行えるため、呼び出し側で文字列を確保する必要がない
+template<size_t InlineSize>
+struct CacheKeyStorage<std::string, InlineSize> {
+    using LookupType = std::string_view;
+
+    char inlineKey[InlineSize];
+    size_t length = 0;
+    std::string overflow;
+
+    void assign(std::string_view k) {
+        length = k.size();
+        if (length <= InlineSize) {
+            memcpy(inlineKey, k.data(), length);
+            overflow.clear();
+        } else {
+            overflow.assign(k.data(), k.size());
+        }
+    }
+    bool equals(std::string_view k) const { return get() == k; }
+    std::string_view get() const {
+        return length <= InlineSize ? std::string_view(inlineKey, length) : std::string_view(overflow);
+    }
+    void clear() {
+        length = 0;
+        overflow.clear();
+    }
+};
 
-template<typename ValueType, size_t MaxSize>
+template<typename ValueType, size_t MaxSize,
+         typename KeyType = std::string,
+         typename Hasher = CacheKeyHasher,
+         size_t InlineKeySize = 48>
 class FixedSizeLRUCache {
+private:
+    using KeyStorage = CacheKeyStorage<KeyType, InlineKeySize>;
+
+public:
+    using LookupKey = typename KeyStorage::LookupType;
+
 private:
     struct CacheEntry {
-        std::string key;
+        KeyStorage key;
+        uint64_t hash;      // キーの完全なハッシュ（比較・再配置用にキャッシュ）
         ValueType value;
         int prev;
         int next;
         bool valid;
 
-        CacheEntry() : prev(-1), next(-1), valid(false) {}
+        CacheEntry() : hash(0), prev(-1), next(-1), valid(false) {}
     };
 
+    // ハッシュテーブルはMaxSizeの2倍以上の2のべき乗（負荷率0.5以下）
+    static constexpr size_t tableSizeFor(size_t n) {
+        size_t size = 1;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+    static constexpr size_t TableSize = tableSizeFor(MaxSize * 2);
+    static constexpr size_t TableMask = TableSize - 1;
+
     CacheEntry entries[MaxSize];
-    int hashTable[MaxSize * 2];
+    int hashTable[TableSize];
+    int freeList[MaxSize];
+    size_t freeCount;
     int head;
     int tail;
     size_t currentSize;
+    Hasher hasher;
 
     static constexpr int EMPTY_SLOT = -1;
 
-    uint32_t hash(const std::string& key) const {
-        uint32_t hash = 0;
-        for (char c : key) {
-            hash = hash * 31 + static_cast<uint32_t>(c);
+    // ハッシュ値が一致したエントリのみキーを比較する
+    int findHashSlot(LookupKey key, uint64_t h) const {
+        size_t slot = h & TableMask;
+
+        while (hashTable[slot] != EMPTY_SLOT) {
+            const CacheEntry& entry = entries[hashTable[slot]];
+            if (entry.hash == h && entry.key.equals(key)) {
+                return static_cast<int>(slot);
+            }
+            slot = (slot + 1) & TableMask;
         }
-        return hash;
+        return -1;
     }
 
-    int findHashSlot(const std::string& key) const {
-        uint32_t h = hash(key) % (MaxSize * 2);
-        int originalH = h;
+    // エントリ番号からスロットを探す（キャッシュ済みハッシュを使うのでキー比較不要）
+    int findSlotOfEntry(int entryIndex) const {
+        size_t slot = entries[entryIndex].hash & TableMask;
 
-        while (hashTable[h] != EMPTY_SLOT) {
-            if (entries[hashTable[h]].valid && entries[hashTable[h]].key == key) {
-                return h;
+        while (hashTable[slot] != EMPTY_SLOT) {
+            if (hashTable[slot] == entryIndex) {
+                return static_cast<int>(slot);
             }
-            h = (h + 1) % (MaxSize * 2);
-            if (h == originalH) break;
+            slot = (slot + 1) & TableMask;
         }
         return -1;
     }
 
-    int findEmptyHashSlot(const std::string& key) const {
-        uint32_t h = hash(key) % (MaxSize * 2);
-        int originalH = h;
+    size_t findEmptyHashSlot(uint64_t h) const {
+        size_t slot = h & TableMask;
 
-        while (hashTable[h] != EMPTY_SLOT) {
-            h = (h + 1) % (MaxSize * 2);
-            if (h == originalH) return -1;
+        // 負荷率0.5以下なので必ず空きがある
+        while (hashTable[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & TableMask;
         }
-        return h;
+        return slot;
+    }
+
+    // 線形探索の後方シフト削除（墓標を残さず、探索チェーンを短く保つ）
+    void eraseHashSlot(size_t slot) {
+        size_t hole = slot;
+        size_t i = slot;
+
+        while (true) {
+            i = (i + 1) & TableMask;
+            if (hashTable[i] == EMPTY_SLOT) {
+                break;
+            }
+
+            size_t ideal = entries[hashTable[i]].hash & TableMask;
+            if (((i - ideal) & TableMask) >= ((i - hole) & TableMask)) {
+                hashTable[hole] = hashTable[i];
+                hole = i;
+            }
+        }
+        hashTable[hole] = EMPTY_SLOT;
     }
 
     void moveToFront(int index) {
@@ -100,24 +234,30 @@ private:
         entries[index].next = -1;
     }
 
-    int findEmptyEntry() const {
-        for (int i = 0; i < MaxSize; i++) {
-            if (!entries[i].valid) {
-                return i;
-            }
+    void resetFreeList() {
+        for (size_t i = 0; i < MaxSize; i++) {
+            freeList[i] = static_cast<int>(MaxSize - 1 - i);
         }
-        return -1;
+        freeCount = MaxSize;
     }
 
 public:
     FixedSizeLRUCache() : head(-1), tail(-1), currentSize(0) {
-        for (int i = 0; i < MaxSize * 2; i++) {
+        for (size_t i = 0; i < TableSize; i++) {
             hashTable[i] = EMPTY_SLOT;
         }
+        resetFreeList();
+    }
+
+    bool put(LookupKey key, const ValueType& value) {
+        return put(key, value, [](LookupKey) {});
     }
 
-    bool put(const std::string& key, const ValueType& value) {
-        int hashSlot = findHashSlot(key);
+    // 満杯時に追い出したキーをonEvict(key)で通知する版
+    template<typename OnEvict>
+    bool put(LookupKey key, const ValueType& value, OnEvict&& onEvict) {
+        uint64_t h = hasher(key);
+        int hashSlot = findHashSlot(key, h);
 
         if (hashSlot != -1) {
             int entryIndex = hashTable[hashSlot];
@@ -126,27 +266,25 @@ public:
             return true;
         }
 
-        int entryIndex = findEmptyEntry();
-        if (entryIndex == -1) {
-            if (currentSize >= MaxSize) {
-                entryIndex = tail;
-                int oldHashSlot = findHashSlot(entries[entryIndex].key);
-                if (oldHashSlot != -1) {
-                    hashTable[oldHashSlot] = EMPTY_SLOT;
-                }
-                removeFromList(entryIndex);
-                currentSize--;
-            } else {
-                return false;
+        int entryIndex;
+        if (freeCount > 0) {
+            entryIndex = freeList[--freeCount];
+        } else {
+            // 満杯: 最も古いエントリを追い出して再利用
+            entryIndex = tail;
+            int oldHashSlot = findSlotOfEntry(entryIndex);
+            if (oldHashSlot != -1) {
+                eraseHashSlot(oldHashSlot);
             }
+            removeFromList(entryIndex);
+            currentSize--;
+            onEvict(entries[entryIndex].key.get());
         }
 
-        int newHashSlot = findEmptyHashSlot(key);
-        if (newHashSlot == -1) {
-            return false;
-        }
+        size_t newHashSlot = findEmptyHashSlot(h);
 
-        entries[entryIndex].key = key;
+        entries[entryIndex].key.assign(key);
+        entries[entryIndex].hash = h;
         entries[entryIndex].value = value;
         entries[entryIndex].valid = true;
         hashTable[newHashSlot] = entryIndex;
@@ -166,34 +304,54 @@ public:
         return true;
     }
 
-    bool get(const std::string& key, ValueType& value) {
-        int hashSlot = findHashSlot(key);
-        if (hashSlot == -1) {
+    bool get(LookupKey key, ValueType& value) {
+        ValueType* found = find(key);
+        if (!found) {
             return false;
         }
 
+        value = *found;
+        return true;
+    }
+
+    // コピーせずに値を参照（LRU順序を更新する）
+    ValueType* find(LookupKey key) {
+        int hashSlot = findHashSlot(key, hasher(key));
+        if (hashSlot == -1) {
+            return nullptr;
+        }
+
         int entryIndex = hashTable[hashSlot];
-        value = entries[entryIndex].value;
         moveToFront(entryIndex);
-        return true;
+        return &entries[entryIndex].value;
     }
 
-    bool contains(const std::string& key) const {
-        return findHashSlot(key) != -1;
+    // コピーせずに値を参照（LRU順序は変えない）
+    const ValueType* peek(LookupKey key) const {
+        int hashSlot = findHashSlot(key, hasher(key));
+        if (hashSlot == -1) {
+            return nullptr;
+        }
+        return &entries[hashTable[hashSlot]].value;
     }
 
-    bool remove(const std::string& key) {
-        int hashSlot = findHashSlot(key);
+    bool contains(LookupKey key) const {
+        return findHashSlot(key, hasher(key)) != -1;
+    }
+
+    bool remove(LookupKey key) {
+        int hashSlot = findHashSlot(key, hasher(key));
         if (hashSlot == -1) {
             return false;
         }
 
         int entryIndex = hashTable[hashSlot];
-        hashTable[hashSlot] = EMPTY_SLOT;
+        eraseHashSlot(hashSlot);
         removeFromList(entryIndex);
 
         entries[entryIndex].valid = false;
         entries[entryIndex].key.clear();
+        freeList[freeCount++] = entryIndex;
         currentSize--;
 
         return true;
@@ -208,28 +366,39 @@ public:
     }
 
     void clear() {
-        for (int i = 0; i < MaxSize; i++) {
+        for (size_t i = 0; i < MaxSize; i++) {
             entries[i].valid = false;
             entries[i].key.clear();
             entries[i].prev = -1;
             entries[i].next = -1;
         }
-        for (int i = 0; i < MaxSize * 2; i++) {
+        for (size_t i = 0; i < TableSize; i++) {
             hashTable[i] = EMPTY_SLOT;
         }
+        resetFreeList();
         head = -1;
         tail = -1;
         currentSize = 0;
     }
 
+    // 新しい順に全エントリをfn(key, value)で走査（LRU順序は変えない）
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        int current = head;
+        while (current != -1) {
+            fn(entries[current].key.get(), entries[current].value);
+            current = entries[current].next;
+        }
+    }
+
     void printCache() const {
         std::cout << "=== LRU Cache (Size: " << currentSize << "/" << MaxSize << ") ===" << std::endl;
         int current = head;
-        int index = 0;
+        size_t index = 0;
 
         while (current != -1 && index < MaxSize) {
             if (entries[current].valid) {
-                std::cout << "[" << index++ << "] Key: " << entries[current].key << std::endl;
+                std::cout << "[" << index++ << "] Key: " << entries[current].key.get() << std::endl;
             }
             current = entries[current].next;
         }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// 6バイトのMACアドレス（インライン保持、ヒープ確保なし）
+struct MacAddress {
+    // "AA:BB:CC:DD:EE:FF" + 終端
+    static constexpr size_t kStringSize = 18;
+
+    uint8_t bytes[6] = {0, 0, 0, 0, 0, 0};
+
+    // "AA:BB:CC:DD:EE:FF" 形式を解析
+    static bool parse(std::string_view text, MacAddress& out) {
+        if (text.size() != kStringSize - 1) {
+            return false;
+        }
+        for (size_t i = 0; i < 6; i++) {
+            int hi = hexValue(text[i * 3]);
+            int lo = hexValue(text[i * 3 + 1]);
+            if (hi < 0 || lo < 0 || (i < 5 && text[i * 3 + 2] != ':')) {
+                return false;
+            }
+            out.bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+        }
+        return true;
+    }
+
+    // outにはkStringSizeバイト以上が必要
+    void format(char* out) const {
+        static const char digits[] = "0123456789ABCDEF";
+        for (size_t i = 0; i < 6; i++) {
+            out[i * 3] = digits[bytes[i] >> 4];
+            out[i * 3 + 1] = digits[bytes[i] & 0x0F];
+            out[i * 3 + 2] = (i < 5) ? ':' : '\0';
+        }
+    }
+
+    std::string toString() const {
+        char buf[kStringSize];
+        format(buf);
+        return std::string(buf);
+    }
+
+    bool operator==(const MacAddress& other) const {
+        return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+    bool operator!=(const MacAddress& other) const { return !(*this == other); }
+
+private:
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+};
@@ -1,29 +1,140 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "uart_receiver.h"
 #include "packet_parser.h"
 #include "cefore_interface.h"
 #include "name_mapper.h"
 #include "gateway_fib.h"
+#include "fragment_reassembler.h"
+#include "gateway_config.h"
+#include "event_loop.h"
+#include "popularity_tracker.h"
+#include "admission_controller.h"
+#include "sensor_history.h"
+#include "duplicate_filter.h"
+#include "fib_replicator.h"
+#include "control_server.h"
+#include "traffic_capture.h"
+#include "segment_store.h"
 
 class MainController {
 public:
     MainController();
     ~MainController();
 
-    bool initialize(const std::string& uart_device, int baudrate);
+    bool initialize(const GatewayConfig& config);
+    // SIGINT/SIGTERMを受けるまで動作（SIGUSR1ではトレースをダンプして継続）（スレッド生成前にblockSignals()を呼んでおくこと）
     void run();
     void shutdown();
 
+    // 制御用シグナルを呼び出しスレッド（と以降に生成されるスレッド）でブロック
+    static void blockSignals();
+
+    // 各スレッドの起床遅延を出力（リアルタイムモード時）
+    void reportJitter(std::ostream& os) const;
+
+    // パケットトレースをJSONで書き出す（SIGUSR1）
+    void dumpTrace();
+
 private:
+    // 周期処理の間隔
+    static constexpr uint32_t kTickIntervalMs = 100;
+
+    // 制御ソケットで読み書きできる設定値
+    struct Tunable {
+        const char* name;
+        const char* help;
+        std::function<uint32_t()> get;
+        std::function<bool(uint32_t)> set;    // 範囲外ならfalse
+    };
+
+    void registerControlCommands();
+    void addTunables();
+    void reportStats(std::ostream& os) const;
+
+    void runThreaded();
+    void runEventLoop();
+    // キャプチャの受信行を記録時のタイミング（またはできるだけ速く）で流し込み、スループットを報告する
+    void runReplay();
+    void onTick();
+    // cefnetdのソケットをepollに登録する（特定できなければ1msポーリングに切り替える）
+    void watchCeforeSocket();
+
     void onRxPacket(const RxPacket& packet);
     void onInterest(const std::string& uri, uint32_t chunk_num);
+    // 分割して保持している大きなデータのチャンク要求に答えられればtrue
+    bool answerFromSegments(const std::string& uri, uint32_t chunk_num);
+    // 履歴の問い合わせ（/name/<ms>, latest, since=, range=）に答えられればtrue
+    bool answerFromHistory(const std::string& uri, uint32_t chunk_num);
+    // FIBで解決したMACへInterestを送り、送信数を返す（宛先数がmax_sendsを超える場合は送らない）
+    // 流量制御で超過した場合、deferrableなら保留して後で再送し、そうでなければ破棄する
+    // routableにはFIBに経路があったか（送信数が0でも流量制御で止めただけか）を返す
+    size_t forwardInterest(std::string_view content_name, size_t max_sends = SIZE_MAX,
+                           bool deferrable = true, bool* routable = nullptr);
+    // 流量制御で保留したInterestのうち送れるようになったものを送る
+    void retryDeferredInterests();
+    void prefetchPopular();
+    void onFragment(const RxPacket& packet, const IcsnPacketView& fragment);
+    // FIBに学習し、経路が増えたら他のゲートウェイへ複製する
+    // worse_macを指定した場合はその（より遠い）経路を外して置き換える
+    void learnRoute(std::string_view content_name, const MacAddress& sender_mac,
+                    const MacAddress* worse_mac = nullptr);
+    void publishSensorData(std::string_view content_name,
+                           const MacAddress& sender_mac,
+                           uint8_t hop_count,
+                           const uint8_t* payload,
+                           size_t payload_len);
+
+    GatewayConfig config_;
+    uint64_t last_report_ms_ = 0;
+    uint64_t last_prefetch_ms_ = 0;
+    bool shut_down_ = false;
+
+    // イベントループモードのみ（cefnetd再接続時にソケットを登録し直す）
+    EventLoop* event_loop_ = nullptr;
+    int cefore_fd_ = -1;
+    // cefnetdのソケットを特定できないときの1msポーリング（タイマーは一度だけ登録し、フラグで止める）
+    bool cefore_polling_ = false;
+    bool cefore_poll_timer_ = false;
 
     std::unique_ptr<UARTReceiver> uart_;
     std::unique_ptr<PacketParser> parser_;
     std::unique_ptr<CeforeInterface> cefore_;
     std::unique_ptr<NameMapper> name_mapper_;
     std::unique_ptr<GatewayFIB> fib_;
+    std::unique_ptr<FragmentReassembler> reassembler_;
+    std::unique_ptr<PopularityTracker> popularity_;
+    std::unique_ptr<AdmissionController> admission_;
+    std::unique_ptr<SensorHistory> history_;
+    std::unique_ptr<DuplicateFilter> dedup_;
+    std::unique_ptr<FibReplicator> replicator_;
+    std::unique_ptr<ControlServer> control_;
+    std::unique_ptr<TrafficCapture> capture_;
+    std::unique_ptr<SegmentStore> segments_;
+
+    // 制御ソケットから変更される公開パラメータ（UART受信スレッドが読む）
+    std::atomic<uint32_t> cache_time_sec_{300};
+    std::atomic<uint32_t> expiry_sec_{3600};
+    // 経路のあったInterestのうち転送できた数・流量制御で止めた数（制御ソケットのstatsが読む）
+    std::atomic<uint64_t> interests_forwarded_{0};
+    std::atomic<uint64_t> interests_held_{0};
+    std::vector<Tunable> tunables_;
+
+    // RX経路で使い回すバッファ（UART受信スレッド専用）
+    std::string reassembled_name_;
+    std::vector<uint8_t> reassembled_payload_;
+    std::string publish_uri_;
+    std::string learned_name_;
+
+    // 履歴応答・チャンクの組み立てバッファ（Interest受信スレッド専用）
+    std::vector<uint8_t> history_buff_;
+    std::vector<uint8_t> segment_buff_;
 };
@@ -1,15 +1,23 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 class NameMapper {
 public:
     // ICSNコンテンツ名にタイムスタンプを付加
-    std::string addTimestamp(const std::string& icsn_content_name);
+    std::string addTimestamp(std::string_view icsn_content_name);
+
+    // outに書き込む版（outの容量を再利用するため定常状態でヒープ確保しない）
+    // 付加したタイムスタンプを返す
+    uint64_t addTimestamp(std::string_view icsn_content_name, std::string& out);
 
     // タイムスタンプ付き名前からICSNコンテンツ名を抽出
     std::string removeTimestamp(const std::string& timestamped_name);
 
+    // CEFOREのURI表記の "ccnx:" を除く（Interestの名前と記録した名前を比較するため）
+    static std::string_view stripScheme(std::string_view uri);
+
 private:
     uint64_t getCurrentTimeMs();
 };
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "icsn_packet.h"
+
+class PacketBufferPool;
+
+// プールから借りた固定長バッファ（ムーブのみ、破棄時にプールへ返却）
+class PacketBuffer {
+public:
+    PacketBuffer() : pool_(nullptr), data_(nullptr), index_(-1), size_(0) {}
+    PacketBuffer(PacketBuffer&& other) noexcept;
+    PacketBuffer& operator=(PacketBuffer&& other) noexcept;
+    PacketBuffer(const PacketBuffer&) = delete;
+    PacketBuffer& operator=(const PacketBuffer&) = delete;
+    ~PacketBuffer() { release(); }
+
+    bool valid() const { return data_ != nullptr; }
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const;
+    void resize(size_t size) { size_ = size; }
+
+    // プールへ返却
+    void release();
+
+private:
+    friend class PacketBufferPool;
+    PacketBuffer(PacketBufferPool* pool, uint8_t* data, int index)
+        : pool_(pool), data_(data), index_(index), size_(0) {}
+
+    PacketBufferPool* pool_;
+    uint8_t* data_;
+    int index_;
+    size_t size_;
+};
+
+// 受信パケット用の固定長バッファのスラブ
+// 起動時に全バッファを確保し、以降はフリーリストで再利用する
+class PacketBufferPool {
+public:
+    // ESP-NOWフレーム1つ分（Base64デコード後）
+    static constexpr size_t kBufferSize = 256;
+    static constexpr size_t kBufferCount = 32;
+
+    PacketBufferPool();
+
+    // 空きがなければ無効なバッファを返す
+    PacketBuffer acquire();
+
+    size_t available() const;
+    uint64_t exhaustedCount() const { return exhausted_; }
+
+private:
+    friend class PacketBuffer;
+    void release(int index);
+
+    alignas(8) uint8_t storage_[kBufferCount][kBufferSize];
+    int freeList_[kBufferCount];
+    size_t freeCount_;
+    uint64_t exhausted_;
+    mutable std::mutex mutex_;
+};
+
+static_assert(PacketBufferPool::kBufferSize >= IcsnPacketView::kMaxFrameSize,
+              "pool buffers must hold a whole ESP-NOW frame");
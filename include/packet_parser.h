@@ -1,16 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
+#include "icsn_packet.h"
 
 class PacketParser {
 public:
-    struct SensorData {
-        char signal_code[10];      // シグナルコード ("DATA" または "INTEREST")
-        uint8_t hop_count;         // ホップカウント
-        char content_name[100];    // コンテンツ名
-        char content[20];          // コンテンツ本体
-    };
-
-    bool parse(const std::vector<uint8_t>& raw_data, SensorData& output);
+    // 受信バッファ上のICSNフレームを解析（コピーせずビューを返す）
+    bool parse(const uint8_t* raw_data, size_t len, IcsnPacketView& output);
+    bool parse(const std::vector<uint8_t>& raw_data, IcsnPacketView& output);
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// パケット単位のトレース
+// 受信時にIDを振り、各処理段階の単調時刻を事前確保したロックフリーのリングに記録する
+// ダンプはChrome trace / Perfetto形式のJSON
+// 無効時は各記録点でatomic<bool>を1回読むだけ
+
+enum class TracePath : uint8_t {
+    Uplink = 1,     // ICSN → CEFORE（UART受信からの公開）
+    Downlink = 2,   // CEFORE → ICSN（Interest受信からのUART送信）
+};
+
+enum class TraceStage : uint8_t {
+    Received = 0,   // 行の受信完了 / cefnetdからの読み込み
+    Decoded,        // Base64・TLVのデコード完了
+    Parsed,         // ICSNフレーム・名前の解析完了
+    FibDone,        // FIB学習・検索完了
+    FrameBuilt,     // 送信フレーム（Content Object / ICSN Interest）構築完了
+    Written,        // cefnetd・UARTへの書き込み完了
+};
+
+class PacketTracer {
+public:
+    static constexpr size_t kRingSize = 16384;   // 2のべき乗
+
+    static void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 新しいパケットのトレースを開始し、呼び出しスレッドの現在IDにする
+    static uint32_t begin(TracePath path) {
+        if (!enabled()) {
+            currentId_ = 0;
+            return 0;
+        }
+        currentId_ = (nextId_.fetch_add(1, std::memory_order_relaxed) << 2) | static_cast<uint32_t>(path);
+        record(currentId_, TraceStage::Received);
+        return currentId_;
+    }
+
+    // 現在のスレッドで処理中のパケットに段階を記録
+    static void mark(TraceStage stage) {
+        if (currentId_ != 0 && enabled()) {
+            record(currentId_, stage);
+        }
+    }
+
+    // 別スレッドへ受け渡したパケットに段階を記録
+    static void mark(uint32_t id, TraceStage stage) {
+        if (id != 0 && enabled()) {
+            record(id, stage);
+        }
+    }
+
+    static uint32_t currentId() { return currentId_; }
+    static void setCurrentId(uint32_t id) { currentId_ = id; }
+
+    // リングの内容をJSONでファイルに書き出す（記録中でもよい）
+    static bool dump(const std::string& path);
+
+private:
+    struct Event {
+        std::atomic<uint64_t> seq;   // 書き込み完了時に通し番号+1を設定（ダンプ時の整合性確認）
+        uint64_t timestampNs;
+        uint32_t id;
+        uint32_t tid;
+        uint8_t stage;
+    };
+
+    static void record(uint32_t id, TraceStage stage);
+
+    static std::atomic<bool> enabled_;
+    static std::atomic<uint32_t> nextId_;
+    static std::atomic<uint64_t> writeIndex_;
+    static Event ring_[kRingSize];
+    static thread_local uint32_t currentId_;
+};
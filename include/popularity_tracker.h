@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+// Interest人気度の追跡
+// Count-Min Sketchで名前ごとの要求回数を近似し、上位K件(Heavy Hitters)を保持する
+// decay()で全カウンタを半減させ、直近の人気を反映させる
+class PopularityTracker {
+public:
+    static constexpr size_t kDepth = 4;
+    static constexpr size_t kWidth = 1024;
+    static constexpr size_t kMaxTopK = 16;
+    static constexpr size_t kMaxNameSize = 100;
+
+    struct Entry {
+        char name[kMaxNameSize];
+        uint32_t estimate;
+    };
+
+    explicit PopularityTracker(size_t top_k = 8);
+
+    // Interestを1件記録
+    void record(std::string_view name);
+
+    // 推定回数の多い順にoutへ書き出し、件数を返す
+    size_t topK(Entry* out, size_t max) const;
+
+    // 全カウンタを半減
+    void decay();
+
+    uint32_t estimate(std::string_view name) const;
+
+private:
+    uint32_t estimateLocked(const uint64_t* hashes) const;
+    static void hashes(std::string_view name, uint64_t* out);
+
+    uint32_t sketch_[kDepth][kWidth];
+    Entry top_[kMaxTopK];
+    size_t topCount_;
+    size_t topLimit_;
+    mutable std::mutex mutex_;
+};
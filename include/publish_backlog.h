@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 公開待ちバックログの設定
+struct BacklogConfig {
+    size_t capacity = 64;                   // メモリ上に保持する件数
+    std::string path;                       // 空でなければメモリが溢れた分をこのファイルへ退避
+    size_t max_file_bytes = 16 * 1024 * 1024;
+    uint32_t drain_per_tick = 20;           // 再接続後、周期処理1回あたりに再公開する件数
+};
+
+// cefnetdへ公開できなかったContent Objectを保持する有界キュー
+// メモリ上の固定長リングが満杯になったらファイルへ追記し、FIFO順を保って取り出す
+// ファイルもない（または上限に達した）場合は最も古いものを捨てる
+class PublishBacklog {
+public:
+    static constexpr size_t kMaxUriSize = 256;
+    static constexpr size_t kMaxPayload = 4096;
+
+    struct Entry {
+        uint64_t createdMs;     // 公開を試みた時刻（壁時計）
+        uint32_t chunkNum;
+        uint32_t endChunkNum;   // 分割しない公開ではUINT32_MAX
+        uint32_t cacheTimeSec;
+        uint32_t expirySec;
+        uint16_t uriLen;
+        uint32_t payloadLen;
+        char uri[kMaxUriSize];
+        uint8_t payload[kMaxPayload];
+
+        std::string_view uriView() const { return std::string_view(uri, uriLen); }
+    };
+
+    struct Stats {
+        uint64_t queued = 0;
+        uint64_t spilled = 0;       // ファイルへ退避した件数
+        uint64_t replayed = 0;
+        uint64_t dropped = 0;       // 溢れて捨てた件数
+        uint64_t expired = 0;       // 有効期限切れで捨てた件数
+    };
+
+    explicit PublishBacklog(const BacklogConfig& config);
+    ~PublishBacklog();
+
+    PublishBacklog(const PublishBacklog&) = delete;
+    PublishBacklog& operator=(const PublishBacklog&) = delete;
+
+    bool push(std::string_view uri, const uint8_t* payload, size_t payload_len,
+              uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+              uint32_t end_chunk_num);
+
+    // 先頭から最大max件をpublish(entry)で再公開し、件数を返す
+    // publishがfalseを返したら（再び切断された等）その件を先頭に残して止める
+    template<typename Publish>
+    size_t drain(size_t max, Publish&& publish);
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    const BacklogConfig& config() const { return config_; }
+    Stats stats() const;
+
+private:
+    bool spillLocked(const Entry& entry);
+    bool unspillLocked(Entry& entry);
+    void refillFromFileLocked();
+    Entry& tailSlotLocked() { return ring_[(head_ + count_) % ring_.size()]; }
+    static uint64_t nowMs();
+
+    BacklogConfig config_;
+    std::vector<Entry> ring_;
+    size_t head_;
+    size_t count_;
+
+    // 退避ファイル（[ヘッダ][URI][ペイロード]を追記し、読み出し位置から順に取り出す）
+    int fd_;
+    uint64_t readOffset_;
+    uint64_t writeOffset_;
+    size_t fileCount_;
+
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+template<typename Publish>
+size_t PublishBacklog::drain(size_t max, Publish&& publish) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t now_ms = nowMs();
+    size_t replayed = 0;
+
+    while (replayed < max && count_ > 0) {
+        Entry& entry = ring_[head_];
+
+        // 有効期限を過ぎたものは公開しても意味がない
+        if (now_ms - entry.createdMs >= static_cast<uint64_t>(entry.expirySec) * 1000) {
+            stats_.expired++;
+        } else {
+            if (!publish(entry)) {
+                break;
+            }
+            stats_.replayed++;
+            replayed++;
+        }
+
+        head_ = (head_ + 1) % ring_.size();
+        count_--;
+        refillFromFileLocked();
+    }
+    return replayed;
+}
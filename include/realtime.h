@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// ゲートウェイのスレッド種別
+enum class GatewayThread {
+    UartRx = 0,
+    UartTx,
+    CeforeRx,
+    Count,
+};
+
+const char* toString(GatewayThread thread);
+
+// リアルタイム動作設定（既定は無効）
+struct RealtimeConfig {
+    static constexpr size_t kThreadCount = static_cast<size_t>(GatewayThread::Count);
+
+    bool enabled = false;
+    bool lock_memory = true;                  // mlockall
+    size_t prefault_stack_bytes = 256 * 1024; // スレッド開始時にスタックを先行確保
+    int cpu[kThreadCount] = {-1, -1, -1};     // -1: 固定しない
+    int priority[kThreadCount] = {0, 0, 0};   // 0: SCHED_OTHER, 1〜99: SCHED_FIFO
+};
+
+class Realtime {
+public:
+    // 現在・将来のページをすべてロック
+    static bool lockMemory();
+
+    // スタックをbytesだけ触ってページフォルトを先に済ませる
+    static void prefaultStack(size_t bytes);
+
+    // 呼び出しスレッドにCPU固定とスケジューリングポリシーを適用
+    static bool applyToCurrentThread(const RealtimeConfig& config, GatewayThread thread);
+};
+
+// 起床遅延の計測（固定ヒストグラム、ロックフリー）
+class JitterProbe {
+public:
+    static constexpr uint64_t kBucketWidthNs = 10 * 1000;  // 10us
+    static constexpr size_t kBucketCount = 1000;           // 〜10ms、それ以上は最終バケット
+
+    JitterProbe();
+
+    void record(uint64_t latency_ns);
+    void reset();
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t maxNs() const { return max_.load(std::memory_order_relaxed); }
+
+    // パーセンタイル（バケット上限値、ns）
+    uint64_t percentileNs(double p) const;
+
+    void report(std::ostream& os, const char* name) const;
+
+    static uint64_t nowNs();
+
+private:
+    std::atomic<uint32_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+};
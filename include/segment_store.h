@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 大きなContent Objectの分割公開の設定（既定は無効）
+struct SegmentConfig {
+    bool enabled = false;
+    size_t segment_size = 1024;     // 1チャンクのペイロード長（公開キュー1スロットに収まること）
+    uint32_t window = 8;            // 順番に要求されたとき先に公開しておくチャンク数
+};
+
+// 1つのContent Objectに収まらない大きなデータ（再構築したデータ、履歴の範囲応答など）を
+// 名前ごとに保持し、Interestのチャンク番号に応じて該当するチャンクを切り出す
+// 要求が前回の続きのチャンクなら順次取得とみなし、後続のwindow個をまとめて先に公開させる
+// （cefnetdのキャッシュに載せておき、消費者のパイプラインを待たせない）
+// UART受信スレッド（put）とInterest受信スレッド（request/copy）から呼ばれるためロックで保護する
+class SegmentStore {
+public:
+    static constexpr size_t kMaxObjects = 16;
+    static constexpr size_t kMaxObjectSize = 64 * 1024;
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    // 1回の要求に対して公開するチャンク
+    // 要求されたチャンクは毎回公開し、順次取得なら未公開の後続を先読みとして足す
+    struct Plan {
+        uint32_t endChunk;          // 最終チャンク番号
+        uint32_t cacheTimeSec;      // put()で指定した値
+        uint32_t expirySec;
+        uint32_t chunk;             // 要求されたチャンク
+        uint32_t prefetchFrom;      // 先読み範囲（両端含む、From > Toなら先読みなし）
+        uint32_t prefetchTo;
+    };
+
+    struct Stats {
+        uint64_t stored = 0;
+        uint64_t requests = 0;
+        uint64_t sequential = 0;
+        uint64_t prefetched = 0;    // 要求より先に公開したチャンク数
+        uint64_t misses = 0;        // 保持していない（期限切れ・範囲外）チャンクの要求
+        uint64_t evicted = 0;       // 期限内に追い出した数
+    };
+
+    explicit SegmentStore(const SegmentConfig& config);
+
+    // 名前でデータを保持し（同じ名前は置き換え）、最終チャンク番号を返す（大きすぎる場合はkNone）
+    // キャッシュ時間を過ぎたものは要求に応じない
+    uint32_t put(std::string_view name, const uint8_t* data, size_t len,
+                 uint32_t cache_time_sec, uint32_t expiry_sec);
+
+    // 要求されたチャンクに対して公開すべき範囲を決める（保持していない、範囲外ならfalse）
+    bool request(std::string_view name, uint32_t chunk, Plan& plan);
+
+    // チャンクの内容をoutへコピーして長さを返す（保持していなければ-1）
+    long copy(std::string_view name, uint32_t chunk, uint8_t* out, size_t capacity) const;
+
+    size_t segmentSize() const { return config_.segment_size; }
+    uint32_t window() const;
+    void setWindow(uint32_t window);
+    // 1つのチャンクで収まるならtrue（分割しない）
+    bool fitsInOne(size_t len) const { return len <= config_.segment_size; }
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    struct Object {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint32_t endChunk = 0;
+        uint32_t cacheTimeSec = 0;
+        uint32_t expirySec = 0;
+        uint64_t expiresMs = 0;
+        uint64_t lastAccessMs = 0;
+        uint32_t lastRequested = kNone;     // 直前に要求されたチャンク
+        uint32_t publishedUpTo = kNone;     // ここまで公開済み（先読み分を含む）
+    };
+
+    Object* findLocked(std::string_view name, uint64_t now_ms);
+    const Object* findLocked(std::string_view name, uint64_t now_ms) const;
+    static uint64_t nowMs();
+
+    SegmentConfig config_;
+    std::vector<Object> objects_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
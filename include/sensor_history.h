@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+
+// センサー名ごとの直近の計測値履歴
+// 名前ごとに固定長のリングを持ち、列指向（時刻・長さ・値の配列）で保持する
+// 領域は1つの連続したブロックで、ファイルを指定するとmmapで永続化する（再起動後も引き継ぐ）
+//
+// Interest名の末尾要素で履歴を問い合わせる（名前の "ccnx:" は記録・検索とも除いて扱う）
+//   /name/<ms>             その時刻の計測値（ゲートウェイが公開した /name/<ms> と同じ内容）
+//   /name/latest           最新の計測値
+//   /name/since=<ms>       指定時刻以降の計測値すべて
+//   /name/range=<ms>-<ms>  指定範囲（両端含む）の計測値すべて
+// 複数件の応答ペイロードは古い順に [時刻 u64 LE][長さ u8][値] を並べたもの
+class SensorHistory {
+public:
+    static constexpr size_t kMaxSeries = 64;
+    static constexpr size_t kSamplesPerSeries = 256;     // 2のべき乗
+    static constexpr size_t kValueStride = 32;           // これより長い値（再構築した大きなデータ等）は保持しない
+    static constexpr size_t kMaxNameSize = 100;
+    static constexpr size_t kRecordHeaderSize = 9;       // 複数件応答の1件あたりのヘッダ
+
+    struct Query {
+        enum class Kind { Exact, Latest, Since, Range };
+        Kind kind = Kind::Exact;
+        uint64_t from = 0;
+        uint64_t to = 0;
+    };
+
+    SensorHistory();
+    ~SensorHistory();
+
+    SensorHistory(const SensorHistory&) = delete;
+    SensorHistory& operator=(const SensorHistory&) = delete;
+
+    // 領域を確保（pathが空なら匿名メモリ、指定時はファイルをmmapし既存の履歴を読み込む）
+    bool open(const std::string& path = "");
+
+    // 計測値を記録（満杯の名前は最も古い値を上書き、名前数が満杯なら最も長く更新のない名前を追い出す）
+    void record(std::string_view name, uint64_t timestamp_ms, const uint8_t* value, size_t len);
+
+    // 名前の末尾要素を問い合わせとして解釈する（該当しなければfalse）
+    static bool parseQuery(std::string_view component, Query& query);
+
+    // Exact/Latest: 値そのものをoutへ書き込み、長さを返す
+    // Since/Range: 該当する計測値を上記の形式でoutに入るだけ書き込み、長さを返す
+    // 名前の履歴がない、またはExact/Latestで該当なしの場合は-1
+    long lookup(std::string_view name, const Query& query, uint8_t* out, size_t capacity) const;
+
+    size_t seriesCount() const;
+
+private:
+    // 1つの名前の列指向リング
+    struct Series {
+        char name[kMaxNameSize];
+        uint8_t nameLen;
+        uint8_t inUse;
+        uint32_t head;      // 次に書き込む位置
+        uint32_t count;
+        uint64_t lastWriteMs;
+        uint64_t timestamps[kSamplesPerSeries];
+        uint8_t lengths[kSamplesPerSeries];
+        uint8_t values[kSamplesPerSeries][kValueStride];
+    };
+
+    // mmapする領域の先頭（ファイル形式の識別用ヘッダ付き）
+    struct Store {
+        uint32_t magic;
+        uint32_t layout;    // 定数が変わったら互換性なしとして初期化し直す
+        Series series[kMaxSeries];
+    };
+
+    static constexpr uint32_t kMagic = 0x48534E49;   // "INSH"
+    static constexpr uint32_t kLayout =
+        (kMaxSeries << 24) ^ (kSamplesPerSeries << 8) ^ kValueStride;
+
+    int allocateSeries(std::string_view name);
+    void rebuildIndex();
+
+    Store* store_;
+    int fd_;
+    FixedSizeLRUCache<int, kMaxSeries> index_;   // 名前 → series番号
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// シリアルポートの速度設定とカーネルのエラー計数
+// 標準のボーレートはBxxx定数で、それ以外（ESP32の1.5M・2M・3Mなど任意の値）はtermios2のBOTHERで設定する
+// <termios.h>と<asm/termbits.h>は同じ翻訳単位に含められないため、実装をこのファイルに分けている
+class SerialLink {
+public:
+    // TIOCGICOUNTで取得するドライバの累積計数（カーネルでは32bitで、長く動かすと一周する）
+    struct ErrorCounters {
+        bool supported = false;     // 擬似端末やUSB変換器の一部は未対応
+        uint32_t rx = 0;
+        uint32_t tx = 0;
+        uint32_t frame = 0;         // フレーミングエラー（速度不一致・ノイズ）
+        uint32_t overrun = 0;       // UARTのFIFO溢れ（読み出しが間に合わない）
+        uint32_t parity = 0;
+        uint32_t brk = 0;
+        uint32_t buf_overrun = 0;   // ttyバッファ溢れ
+
+        // baseからの増分（一周しても32bitの剰余で正しく求める、どちらかが未対応なら未対応）
+        ErrorCounters since(const ErrorCounters& base) const;
+        // 受信データが壊れた・失われた可能性のある計数の合計
+        uint64_t errors() const {
+            return static_cast<uint64_t>(frame) + overrun + parity + buf_overrun;
+        }
+        // 未対応なら各計数をn/aと出力する（0と区別するため）
+        void print(std::ostream& os) const;
+    };
+
+    // fdの入出力速度を設定し、ドライバが実際に設定した値をactualに返す
+    static bool setBaudrate(int fd, int baudrate, int& actual);
+    // 未対応のドライバではsupported=falseのままtrueを返す
+    static bool readCounters(int fd, ErrorCounters& out);
+};
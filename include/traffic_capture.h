@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// UARTの生の行（RX/TX）を単調時刻付きでバイナリファイルに記録する
+// 記録側は固定長バッファへコピーするだけで、書き込みはバックグラウンドのライタースレッドが行う
+// （バッファが満杯ならその行を捨てて計数する。UARTの処理を待たせない）
+//
+// ファイル形式（ホストバイトオーダー）:
+//   FileHeader
+//   { RecordHeader, 行（改行なし）} の繰り返し
+class TrafficCapture {
+public:
+    enum class Direction : uint8_t {
+        Rx = 0,     // ESP32 → ゲートウェイ（"RX:..."）
+        Tx = 1,     // ゲートウェイ → ESP32（"TX:..."）
+    };
+
+    static constexpr size_t kBufferSize = 256 * 1024;   // ダブルバッファ1面の大きさ
+    static constexpr uint64_t kDefaultMaxBytes = 64ULL * 1024 * 1024;
+    static constexpr size_t kMaxLineSize = 1024;
+
+    struct __attribute__((packed)) FileHeader {
+        char magic[4];          // "ICAP"
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t startRealtimeNs;   // 記録開始時の壁時計（参考）
+    };
+
+    struct __attribute__((packed)) RecordHeader {
+        uint64_t timestampNs;   // CLOCK_MONOTONIC
+        uint8_t direction;
+        uint8_t reserved;
+        uint16_t length;
+    };
+
+    struct Stats {
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        uint64_t dropped = 0;   // バッファ満杯・上限到達で捨てた行
+    };
+
+    // 記録済みファイルを先頭から順に読む
+    class Reader {
+    public:
+        struct Record {
+            uint64_t timestampNs;
+            Direction direction;
+            std::string_view line;  // 次のnext()まで有効
+        };
+
+        ~Reader();
+        bool open(const std::string& path);
+        // 終端または壊れたレコードでfalse
+        bool next(Record& record);
+
+    private:
+        FILE* file_ = nullptr;
+        char line_[kMaxLineSize];
+    };
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    // ファイルを作成してライタースレッドを開始（max_bytesを超えた分は記録しない）
+    bool open(const std::string& path, uint64_t max_bytes = kDefaultMaxBytes);
+    // 残りを書き出してスレッドを止め、ファイルを閉じる
+    void close();
+
+    // 任意のスレッドから呼べる（ブロックしない）
+    void record(Direction direction, const char* line, size_t len);
+
+    Stats stats() const;
+    void report(std::ostream& os) const;
+
+private:
+    void writerLoop();
+
+    int fd_;
+    uint64_t max_bytes_;
+    std::thread writer_;
+    bool running_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<uint8_t> active_;   // 記録側が追記する面
+    std::vector<uint8_t> spare_;    // ライターが書き出す面
+    uint64_t reserved_bytes_;       // ファイルに書く予定の合計（上限判定用）
+    Stats stats_;
+};
@@ -1,35 +1,129 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include "mac_address.h"
+#include "packet_buffer_pool.h"
+#include "realtime.h"
+#include "traffic_capture.h"
+#include "serial_link.h"
 
 struct RxPacket {
-    std::string sender_mac;
+    MacAddress sender_mac;
     uint16_t data_len;
-    std::vector<uint8_t> payload;
+    PacketBuffer payload;   // プールから借りたデコード済みペイロード（コールバック後に返却）
 };
 
 class UARTReceiver {
 public:
+    // 1行の最大長（"RX:" + MAC + 長さ + Base64(250バイト)に余裕を持たせる）
+    static constexpr size_t kMaxLineSize = 512;
+    // 送信キューの深さ（TXライタースレッドが順に書き出す）
+    static constexpr size_t kTxQueueSize = 32;
+
     UARTReceiver(const std::string& device, int baudrate);
     ~UARTReceiver();
 
+    // スレッドモード: ポートを開き受信・TXライタースレッドを開始
     void start();
     void stop();
-    bool sendTxCommand(const std::string& mac, const std::vector<uint8_t>& data);
+
+    // イベントループモード: ポートを開くだけ（スレッドなし、TXは呼び出しスレッドで直接書き込む）
+    bool openPort(bool nonblocking);
+    int fd() const { return fd_; }
+    // fdが読み込み可能になったときに呼ぶ
+    void handleReadable();
+    // リプレイ用: ポートを開かずに動作する（送信行は記録・計数して捨てる）
+    void detach() { detached_ = true; }
+    // リプレイ用: 1行（改行なし）をUARTから受信したものとして処理し、解析できればtrue
+    bool injectLine(std::string_view line);
+
+    bool sendTxCommand(std::string_view mac, const std::vector<uint8_t>& data);
+    bool sendTxCommand(std::string_view mac, const uint8_t* data, size_t len);
     void setRxCallback(std::function<void(const RxPacket&)> callback);
 
+    // "TX:<MAC>|<Base64>\n" 1行の長さ（シリアル上のバイト数）
+    static constexpr size_t txLineLength(size_t mac_len, size_t data_len) {
+        return 3 + mac_len + 1 + (data_len + 2) / 3 * 4 + 1;
+    }
+
+    // start()前に設定すること
+    void setRealtimeConfig(const RealtimeConfig& config) { realtime_ = config; }
+    // RTS/CTSハードウェアフロー制御（openPort()・start()前に設定すること）
+    void setFlowControl(bool rtscts) { rtscts_ = rtscts; }
+    // 受信行・送信行をcaptureに記録する（nullptrで記録しない）
+    void setCapture(TrafficCapture* capture) { capture_ = capture; }
+
+    const JitterProbe& rxJitter() const { return rx_jitter_; }
+    const JitterProbe& txJitter() const { return tx_jitter_; }
+    uint64_t txDropped() const { return tx_dropped_.load(std::memory_order_relaxed); }
+    uint64_t txDiscarded() const { return tx_discarded_.load(std::memory_order_relaxed); }
+
+    // 受信バイト・行数、壊れた行、カーネルのエラー計数（ポートを開いてからの増分）を出力
+    void reportLink(std::ostream& os) const;
+
+    // リンク試験: TXとRXを短絡した（ESP32を外した）ポートにduration_msの間テスト行を送り続け、
+    // 折り返した行を検証してスループット・欠落・誤りを出力する。誤りがなければtrue
+    bool runSelfTest(uint32_t duration_ms, std::ostream& os);
+
 private:
+    struct TxSlot {
+        uint64_t enqueuedNs;
+        uint32_t traceId;   // 送信元パケットのトレースID（0: トレースなし）
+        size_t len;
+        char line[kMaxLineSize];
+    };
+
     void receiveLoop();
-    bool parseLine(const std::string& line, RxPacket& packet);
+    void txLoop();
+    void consumeBytes(const char* data, size_t len);
+    bool handleLine(std::string_view line);
+    bool parseLine(std::string_view line, RxPacket& packet);
+    bool writeLine(const char* line, size_t len);
 
     int fd_;
     std::string device_;
     int baudrate_;
     std::thread recv_thread_;
+    std::thread tx_thread_;
     std::atomic<bool> running_;
     std::function<void(const RxPacket&)> rx_callback_;
+
+    // 受信行バッファ（固定長、ヒープ確保なし）
+    char line_buf_[kMaxLineSize];
+    size_t line_len_;
+    bool line_overflow_;
+    PacketBufferPool pool_;
+
+    // 送信キュー（固定長リング）
+    TxSlot tx_queue_[kTxQueueSize];
+    size_t tx_head_;
+    size_t tx_count_;
+    std::mutex tx_mutex_;
+    std::condition_variable tx_cv_;
+    std::atomic<bool> tx_async_;
+    std::atomic<uint64_t> tx_dropped_;
+    std::atomic<uint64_t> tx_discarded_;    // 切り離し中に捨てた送信行
+    bool detached_;
+    TrafficCapture* capture_;
+
+    // リンク品質（受信はUART受信スレッド、読み出しは周期処理から）
+    bool rtscts_;
+    int actual_baudrate_;                   // ドライバが実際に設定した速度
+    SerialLink::ErrorCounters icount_base_; // ポートを開いた時点のカーネル計数
+    std::atomic<uint64_t> rx_bytes_;
+    std::atomic<uint64_t> rx_lines_;
+    std::atomic<uint64_t> rx_corrupt_;      // 形式の壊れた "RX:" 行（ビット誤り・取りこぼしの目安）
+    std::atomic<uint64_t> rx_overlong_;     // 改行を取りこぼして行バッファを溢れた行
+
+    RealtimeConfig realtime_;
+    JitterProbe rx_jitter_;
+    JitterProbe tx_jitter_;
 };
@@ -0,0 +1,166 @@
+#include "admission_controller.h"
+#include "gateway_clock.h"
+#include <algorithm>
+#include <cstring>
+
+// MACアドレス6バイトを整数キーにする
+static uint64_t macKey(const MacAddress& mac) {
+    uint64_t key = 0;
+    memcpy(&key, mac.bytes, sizeof(mac.bytes));
+    return key;
+}
+
+AdmissionController::AdmissionController(const AdmissionConfig& config, int baudrate)
+    : config_(config), baudrate_(baudrate), deferredCount_(0) {
+    updateSerialRateLocked();
+}
+
+void AdmissionController::updateSerialRateLocked() {
+    // 8N1では1バイトあたり10ビット
+    serialRate_ = baudrate_ / 10.0 * std::min<uint32_t>(config_.serial_share, 100) / 100.0;
+    // 0.2秒分のバーストを許容（最低でも最大長のTX行1本分）
+    serialBurst_ = std::max(serialRate_ * 0.2, 512.0);
+}
+
+uint64_t AdmissionController::nowMs() {
+    // --replay中は記録時刻で判定する
+    return GatewayClock::nowMs();
+}
+
+void AdmissionController::refill(TokenBucket& bucket, double rate, double burst, uint64_t now_ms) {
+    if (bucket.tokens < 0) {
+        bucket.tokens = burst;
+    } else if (now_ms > bucket.lastMs) {
+        bucket.tokens = std::min(burst, bucket.tokens + rate * (now_ms - bucket.lastMs) / 1000.0);
+    }
+    bucket.lastMs = now_ms;
+}
+
+std::string_view AdmissionController::prefixOf(std::string_view content_name) const {
+    // 先頭からprefix_depth階層分（"/a/b/c" → depth=2で"/a/b"）
+    size_t depth = 0;
+    for (size_t i = 1; i < content_name.size(); i++) {
+        if (content_name[i] == '/' && ++depth == config_.prefix_depth) {
+            return content_name.substr(0, i);
+        }
+    }
+    return content_name;
+}
+
+AdmissionController::Limit AdmissionController::tryConsumeLocked(const MacAddress& mac,
+                                                                 std::string_view content_name,
+                                                                 size_t wire_bytes,
+                                                                 uint64_t now_ms) {
+    uint64_t mac_key = macKey(mac);
+    std::string_view prefix = prefixOf(content_name);
+
+    TokenBucket* mac_bucket = macBuckets_.find(mac_key);
+    if (!mac_bucket) {
+        macBuckets_.put(mac_key, TokenBucket());
+        mac_bucket = macBuckets_.find(mac_key);
+    }
+    TokenBucket* prefix_bucket = prefixBuckets_.find(prefix);
+    if (!prefix_bucket) {
+        prefixBuckets_.put(prefix, TokenBucket());
+        prefix_bucket = prefixBuckets_.find(prefix);
+    }
+
+    refill(*mac_bucket, config_.mac_rate, config_.mac_burst, now_ms);
+    refill(*prefix_bucket, config_.prefix_rate, config_.prefix_burst, now_ms);
+    refill(serialBucket_, serialRate_, serialBurst_, now_ms);
+
+    // 3つすべてに余裕があるときだけ消費する
+    if (mac_bucket->tokens < 1.0) {
+        return Limit::Mac;
+    }
+    if (prefix_bucket->tokens < 1.0) {
+        return Limit::Prefix;
+    }
+    if (serialBucket_.tokens < static_cast<double>(wire_bytes)) {
+        return Limit::Serial;
+    }
+
+    mac_bucket->tokens -= 1.0;
+    prefix_bucket->tokens -= 1.0;
+    serialBucket_.tokens -= static_cast<double>(wire_bytes);
+    return Limit::None;
+}
+
+AdmissionController::Decision AdmissionController::admit(const MacAddress& mac,
+                                                         std::string_view content_name,
+                                                         const uint8_t* frame,
+                                                         size_t frame_len,
+                                                         size_t wire_bytes,
+                                                         bool deferrable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t now_ms = nowMs();
+
+    Limit limit = tryConsumeLocked(mac, content_name, wire_bytes, now_ms);
+    if (limit == Limit::None) {
+        stats_.admitted++;
+        return Decision::Admit;
+    }
+
+    if (deferrable && deferredCount_ < kMaxDeferred &&
+        content_name.size() <= sizeof(DeferredInterest::name) &&
+        frame_len <= sizeof(DeferredInterest::frame)) {
+        DeferredInterest& entry = deferred_[deferredCount_++];
+        entry.mac = mac;
+        entry.enqueuedMs = now_ms;
+        entry.wireBytes = wire_bytes;
+        entry.nameLen = static_cast<uint8_t>(content_name.size());
+        entry.frameLen = static_cast<uint8_t>(frame_len);
+        memcpy(entry.name, content_name.data(), content_name.size());
+        memcpy(entry.frame, frame, frame_len);
+        stats_.deferred++;
+        return Decision::Defer;
+    }
+
+    if (deferrable) {
+        stats_.dropped_queue++;
+    } else if (limit == Limit::Mac) {
+        stats_.dropped_mac++;
+    } else if (limit == Limit::Prefix) {
+        stats_.dropped_prefix++;
+    } else {
+        stats_.dropped_serial++;
+    }
+    return Decision::Drop;
+}
+
+AdmissionController::Stats AdmissionController::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void AdmissionController::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "[admission] admitted=" << s.admitted
+       << " deferred=" << s.deferred
+       << " retried=" << s.retried
+       << " expired=" << s.expired
+       << " dropped(mac/prefix/serial/queue/send)=" << s.dropped_mac << "/" << s.dropped_prefix
+       << "/" << s.dropped_serial << "/" << s.dropped_queue << "/" << s.dropped_send << std::endl;
+}
+
+AdmissionConfig AdmissionController::config() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+}
+
+void AdmissionController::setLimits(const AdmissionConfig& limits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_.mac_rate = limits.mac_rate;
+    config_.mac_burst = limits.mac_burst;
+    config_.prefix_rate = limits.prefix_rate;
+    config_.prefix_burst = limits.prefix_burst;
+    config_.serial_share = limits.serial_share;
+    updateSerialRateLocked();
+}
+
+void AdmissionController::reportOccupancy(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "[admission] mac_buckets=" << macBuckets_.size() << "/" << kMaxMacBuckets
+       << " prefix_buckets=" << prefixBuckets_.size() << "/" << kMaxPrefixBuckets
+       << " deferred=" << deferredCount_ << "/" << kMaxDeferred << std::endl;
+}
@@ -1,10 +1,44 @@
 #include "cefore_interface.h"
+#include "packet_tracer.h"
 #include <iostream>
 #include <cstring>
 #include <chrono>
 #include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <set>
+#include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+
+// 現在開いているソケットfdの一覧
+static std::set<int> listSocketFds() {
+    std::set<int> fds;
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return fds;
+    }
+
+    int dir_fd = dirfd(dir);
+    while (struct dirent* entry = readdir(dir)) {
+        int fd = atoi(entry->d_name);
+        struct stat st;
+        if (fd != dir_fd && entry->d_name[0] != '.' &&
+            fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            fds.insert(fd);
+        }
+    }
+    closedir(dir);
+    return fds;
+}
 
-CeforeInterface::CeforeInterface() : handle_(-1), running_(false) {}
+static uint64_t steadyMs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+CeforeInterface::CeforeInterface()
+    : handle_(-1), socket_fd_(-1), handle_generation_(0), reading_handle_(-1), retired_handle_(-1),
+      connected_(false), reconnects_(0), running_(false) {}
 
 CeforeInterface::~CeforeInterface() {
     stopReceiving();
@@ -25,23 +59,177 @@ bool CeforeInterface::init(int port_num, const std::string& config_path) {
     return true;
 }
 
+CefT_Client_Handle CeforeInterface::connectHandle(int* socket_fd) {
+    // cef_client APIはソケットを公開しないため、接続前後で増えたソケットfdを特定する
+    std::lock_guard<std::mutex> lock(connect_mutex_);
+    std::set<int> before = listSocketFds();
+
+    CefT_Client_Handle handle = cef_client_connect();
+    if (handle < 1) {
+        return handle;
+    }
+
+    if (socket_fd) {
+        *socket_fd = -1;
+        for (int fd : listSocketFds()) {
+            if (!before.count(fd)) {
+                *socket_fd = fd;
+                break;
+            }
+        }
+    }
+    return handle;
+}
+
 bool CeforeInterface::connect() {
-    handle_ = cef_client_connect();
+    std::lock_guard<std::mutex> lock(handle_mutex_);
+    handle_ = connectHandle(&socket_fd_);
 
     if (handle_ < 1) {
         std::cerr << "cef_client_connect failed" << std::endl;
         return false;
     }
 
+    connected_ = true;
     std::cout << "Connected to cefnetd (handle=" << handle_ << ")" << std::endl;
     return true;
 }
 
 void CeforeInterface::disconnect() {
+    stopPublishers();
+
+    std::lock_guard<std::mutex> lock(handle_mutex_);
+    if (handle_ >= 1) {
+        retireHandleLocked();
+        socket_fd_ = -1;
+    }
+    connected_ = false;
+}
+
+void CeforeInterface::retireHandleLocked() {
     if (handle_ >= 1) {
-        cef_client_close(handle_);
-        handle_ = -1;
+        if (handle_ == reading_handle_) {
+            // 受信中のハンドルはreadOnceが読み終えてから閉じる
+            retired_handle_ = handle_;
+        } else {
+            cef_client_close(handle_);
+        }
     }
+    handle_ = -1;
+    handle_generation_++;
+}
+
+void CeforeInterface::markDisconnected() {
+    if (connected_.exchange(false)) {
+        std::cerr << "Lost connection to cefnetd" << std::endl;
+    }
+}
+
+bool CeforeInterface::maintainConnection() {
+    if (connected_) {
+        // cefnetdが落ちるとソケットがHUPになる（Interestが来なくても検出できる）
+        int fd = socket_fd_;
+        if (fd >= 0) {
+            struct pollfd pfd = {fd, POLLRDHUP, 0};
+            if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLRDHUP))) {
+                markDisconnected();
+            }
+        }
+        if (connected_) {
+            return false;
+        }
+    }
+
+    uint64_t now_ms = steadyMs();
+    if (backoff_.delayMs == 0) {
+        // 切断を検出した直後は初回の待ち時間を置く
+        backoff_.failed(now_ms);
+        return false;
+    }
+    if (!backoff_.due(now_ms)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(handle_mutex_);
+    retireHandleLocked();
+    socket_fd_ = -1;
+    handle_ = connectHandle(&socket_fd_);
+
+    if (handle_ < 1) {
+        backoff_.failed(now_ms);
+        std::cerr << "Reconnect to cefnetd failed, retrying in " << backoff_.delayMs << " ms" << std::endl;
+        return false;
+    }
+
+    backoff_.reset();
+    connected_ = true;
+    reconnects_.fetch_add(1, std::memory_order_relaxed);
+    std::cout << "Reconnected to cefnetd (handle=" << handle_ << ")" << std::endl;
+    return true;
+}
+
+void CeforeInterface::enableBacklog(const BacklogConfig& config) {
+    backlog_ = std::make_unique<PublishBacklog>(config);
+}
+
+bool CeforeInterface::deferPublish(std::string_view uri, const uint8_t* payload, size_t payload_len,
+                                   uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                                   uint32_t end_chunk_num) {
+    if (!backlog_) {
+        return false;
+    }
+    return backlog_->push(uri, payload, payload_len, chunk_num, cache_time_sec, expiry_sec, end_chunk_num);
+}
+
+size_t CeforeInterface::drainBacklog() {
+    if (!backlog_ || !connected_ || backlog_->empty()) {
+        return 0;
+    }
+    for (const auto& publisher : publishers_) {
+        if (!publisher->connected) {
+            return 0;
+        }
+    }
+
+    // 再接続直後に溜まった分を一度に流さず、周期ごとの上限件数ずつ再公開する
+    uint64_t now_ms = getCurrentTimeMs();
+    size_t replayed = backlog_->drain(backlog_->config().drain_per_tick,
+                                      [this, now_ms](const PublishBacklog::Entry& entry) {
+        // 有効期限は最初に公開を試みた時刻から数える
+        uint32_t elapsed_sec = static_cast<uint32_t>((now_ms - entry.createdMs) / 1000);
+        uint32_t expiry_sec = entry.expirySec > elapsed_sec ? entry.expirySec - elapsed_sec : 1;
+        std::string uri(entry.uriView());
+
+        // ここで失敗したものはバックログの先頭に残る（再度積み直さない）
+        if (!publishers_.empty()) {
+            return enqueuePublish(uri, entry.payload, entry.payloadLen,
+                                  entry.chunkNum, entry.cacheTimeSec, expiry_sec, entry.endChunkNum, true);
+        }
+        PublishResult result = publishOnMain(uri, entry.payload, entry.payloadLen,
+                                             entry.chunkNum, entry.cacheTimeSec, expiry_sec,
+                                             entry.endChunkNum);
+        // 不正なものは再送しても無駄なので取り除く
+        return result != PublishResult::ConnectionLost;
+    });
+
+    if (replayed > 0 && backlog_->empty()) {
+        std::cout << "Publish backlog drained" << std::endl;
+    }
+    return replayed;
+}
+
+void CeforeInterface::reportBacklog(std::ostream& os) const {
+    if (!backlog_) {
+        return;
+    }
+    PublishBacklog::Stats s = backlog_->stats();
+    os << "[backlog] pending=" << backlog_->size()
+       << " queued=" << s.queued
+       << " spilled=" << s.spilled
+       << " replayed=" << s.replayed
+       << " expired=" << s.expired
+       << " dropped=" << s.dropped
+       << " reconnects=" << reconnects_.load(std::memory_order_relaxed) << std::endl;
 }
 
 uint64_t CeforeInterface::getCurrentTimeMs() {
@@ -55,11 +243,57 @@ bool CeforeInterface::publishData(const std::string& uri,
                                    const std::vector<uint8_t>& payload,
                                    uint32_t chunk_num,
                                    uint32_t cache_time_sec,
-                                   uint32_t expiry_sec) {
-    if (handle_ < 1) {
-        return false;
+                                   uint32_t expiry_sec,
+                                   uint32_t end_chunk_num) {
+    return publishData(uri, payload.data(), payload.size(), chunk_num, cache_time_sec, expiry_sec,
+                       end_chunk_num);
+}
+
+bool CeforeInterface::publishData(const std::string& uri,
+                                   const uint8_t* payload,
+                                   size_t payload_len,
+                                   uint32_t chunk_num,
+                                   uint32_t cache_time_sec,
+                                   uint32_t expiry_sec,
+                                   uint32_t end_chunk_num) {
+    if (!publishers_.empty()) {
+        return enqueuePublish(uri, payload, payload_len, chunk_num, cache_time_sec, expiry_sec,
+                              end_chunk_num, false);
     }
 
+    PublishResult result = publishOnMain(uri, payload, payload_len,
+                                         chunk_num, cache_time_sec, expiry_sec, end_chunk_num);
+    if (result == PublishResult::ConnectionLost) {
+        return deferPublish(uri, payload, payload_len, chunk_num, cache_time_sec, expiry_sec,
+                            end_chunk_num);
+    }
+    return result == PublishResult::Ok;
+}
+
+CeforeInterface::PublishResult CeforeInterface::publishOnMain(const std::string& uri,
+                                                              const uint8_t* payload,
+                                                              size_t payload_len,
+                                                              uint32_t chunk_num,
+                                                              uint32_t cache_time_sec,
+                                                              uint32_t expiry_sec,
+                                                              uint32_t end_chunk_num) {
+    std::lock_guard<std::mutex> lock(handle_mutex_);
+    if (!connected_ || handle_ < 1) {
+        return PublishResult::ConnectionLost;
+    }
+
+    PublishResult result = publishOn(handle_, uri.c_str(), payload, payload_len,
+                                     chunk_num, cache_time_sec, expiry_sec, end_chunk_num);
+    if (result == PublishResult::ConnectionLost) {
+        markDisconnected();
+    }
+    return result;
+}
+
+CeforeInterface::PublishResult CeforeInterface::publishOn(CefT_Client_Handle handle, const char* uri,
+                                                          const uint8_t* payload, size_t payload_len,
+                                                          uint32_t chunk_num, uint32_t cache_time_sec,
+                                                          uint32_t expiry_sec, uint32_t end_chunk_num) {
     CefT_CcnMsg_OptHdr opt;
     CefT_CcnMsg_MsgBdy params;
     unsigned char cob_buff[CefC_Max_Length];
@@ -68,23 +302,29 @@ bool CeforeInterface::publishData(const std::string& uri,
     memset(&params, 0, sizeof(params));
 
     // 名前設定
-    params.name_len = cef_frame_conversion_uri_to_name(uri.c_str(), params.name);
+    params.name_len = cef_frame_conversion_uri_to_name(uri, params.name);
     if (params.name_len <= 0) {
         std::cerr << "Invalid URI: " << uri << std::endl;
-        return false;
+        return PublishResult::Invalid;
     }
 
     // チャンク番号設定
     params.chunk_num_f = 1;
     params.chunk_num = chunk_num;
 
+    // 分割したContent Objectには最終チャンク番号を付ける（消費者はこれで取得を終える）
+    if (end_chunk_num != kNoEndChunk) {
+        params.end_chunk_num_f = 1;
+        params.end_chunk_num = end_chunk_num;
+    }
+
     // ペイロード設定
-    if (payload.size() > CefC_Max_Length) {
-        std::cerr << "Payload too large: " << payload.size() << std::endl;
-        return false;
+    if (payload_len > CefC_Max_Length) {
+        std::cerr << "Payload too large: " << payload_len << std::endl;
+        return PublishResult::Invalid;
     }
-    params.payload_len = payload.size();
-    memcpy(params.payload, payload.data(), payload.size());
+    params.payload_len = payload_len;
+    memcpy(params.payload, payload, payload_len);
 
     // 有効期限設定
     uint64_t now_ms = getCurrentTimeMs();
@@ -98,19 +338,209 @@ bool CeforeInterface::publishData(const std::string& uri,
     int cob_len = cef_frame_object_create(cob_buff, &opt, &params);
     if (cob_len < 0) {
         std::cerr << "cef_frame_object_create failed" << std::endl;
-        return false;
+        return PublishResult::Invalid;
     }
+    PacketTracer::mark(TraceStage::FrameBuilt);
 
-    // cefnetdへ送信
-    int res = cef_client_message_input(handle_, cob_buff, cob_len);
+    // cefnetdへ送信（失敗は接続断とみなす）
+    int res = cef_client_message_input(handle, cob_buff, cob_len);
     if (res < 0) {
         std::cerr << "cef_client_message_input failed" << std::endl;
+        return PublishResult::ConnectionLost;
+    }
+    PacketTracer::mark(TraceStage::Written);
+
+    return PublishResult::Ok;
+}
+
+bool CeforeInterface::startPublishers(size_t count) {
+    if (!publishers_.empty() || count == 0) {
+        return publishers_.size() == count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        auto publisher = std::make_unique<Publisher>();
+        publisher->handle = connectHandle(nullptr);
+        publisher->connected = publisher->handle >= 1;
+        if (publisher->handle < 1) {
+            std::cerr << "cef_client_connect failed for publisher " << i << std::endl;
+            stopPublishers();
+            return false;
+        }
+        publishers_.push_back(std::move(publisher));
+    }
+
+    for (auto& publisher : publishers_) {
+        publisher->running = true;
+        publisher->thread = std::thread(&CeforeInterface::publishLoop, this, std::ref(*publisher));
+    }
+
+    std::cout << "Started " << count << " publisher connection(s) to cefnetd" << std::endl;
+    return true;
+}
+
+void CeforeInterface::stopPublishers() {
+    for (auto& publisher : publishers_) {
+        {
+            std::lock_guard<std::mutex> lock(publisher->mutex);
+            publisher->running = false;
+        }
+        publisher->cv.notify_all();
+        if (publisher->thread.joinable()) {
+            publisher->thread.join();
+        }
+        if (publisher->handle >= 1) {
+            cef_client_close(publisher->handle);
+        }
+    }
+    publishers_.clear();
+}
+
+bool CeforeInterface::enqueuePublish(const std::string& uri,
+                                     const uint8_t* payload, size_t payload_len,
+                                     uint32_t chunk_num, uint32_t cache_time_sec,
+                                     uint32_t expiry_sec, uint32_t end_chunk_num, bool from_backlog) {
+    if (uri.size() >= kMaxQueuedUriSize || payload_len > kMaxQueuedPayload) {
+        std::cerr << "Publish too large for queue: " << uri << " (" << payload_len << " bytes)" << std::endl;
         return false;
     }
 
+    // 同じ名前は常に同じ接続で公開し、名前ごとの順序を保つ
+    // URI末尾の要素はNameMapperが付けるタイムスタンプなので除いてハッシュする
+    std::string_view name(uri);
+    size_t last_slash = name.rfind('/');
+    if (last_slash != std::string_view::npos && last_slash > 0) {
+        name = name.substr(0, last_slash);
+    }
+    Publisher& publisher = *publishers_[CacheKeyHasher()(name) % publishers_.size()];
+
+    {
+        std::lock_guard<std::mutex> lock(publisher.mutex);
+        if (publisher.count == kPublishQueueSize) {
+            if (from_backlog) {
+                publisher.refused.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            publisher.dropped.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "Publish queue full, dropping " << uri << std::endl;
+            return false;
+        }
+
+        PublishSlot& slot = publisher.queue[(publisher.head + publisher.count) % kPublishQueueSize];
+        memcpy(slot.uri, uri.c_str(), uri.size() + 1);
+        memcpy(slot.payload, payload, payload_len);
+        slot.payloadLen = payload_len;
+        slot.chunkNum = chunk_num;
+        slot.endChunkNum = end_chunk_num;
+        slot.cacheTimeSec = cache_time_sec;
+        slot.expirySec = expiry_sec;
+        slot.traceId = PacketTracer::currentId();
+        publisher.count++;
+    }
+    publisher.cv.notify_one();
     return true;
 }
 
+void CeforeInterface::publishLoop(Publisher& publisher) {
+    auto ready = [&publisher] { return publisher.count > 0 || !publisher.running; };
+
+    while (true) {
+        PublishSlot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(publisher.mutex);
+            if (publisher.connected) {
+                publisher.cv.wait(lock, ready);
+            } else {
+                // 切断中は次の再接続時刻に起きる
+                uint64_t wait_ms = publisher.backoff.remainingMs(steadyMs());
+                publisher.cv.wait_for(lock, std::chrono::milliseconds(wait_ms), ready);
+            }
+            if (publisher.count == 0 && !publisher.running) {
+                break;
+            }
+            if (publisher.count > 0) {
+                slot = &publisher.queue[publisher.head];
+            }
+        }
+
+        if (!publisher.connected && publisher.running) {
+            reconnectPublisher(publisher);
+        }
+        if (!slot) {
+            continue;
+        }
+
+        // 先頭スロットは書き込み側が触らないため、ロックを外してそのまま公開する
+        PublishResult result = PublishResult::ConnectionLost;
+        if (publisher.connected) {
+            PacketTracer::setCurrentId(slot->traceId);
+            result = publishOn(publisher.handle, slot->uri, slot->payload, slot->payloadLen,
+                               slot->chunkNum, slot->cacheTimeSec, slot->expirySec, slot->endChunkNum);
+            PacketTracer::setCurrentId(0);
+
+            if (result == PublishResult::ConnectionLost) {
+                publisher.connected = false;
+                publisher.backoff.failed(steadyMs());
+                std::cerr << "Publisher connection to cefnetd lost" << std::endl;
+            }
+        }
+
+        if (result == PublishResult::Ok) {
+            publisher.published.fetch_add(1, std::memory_order_relaxed);
+            publisher.bytes.fetch_add(slot->payloadLen, std::memory_order_relaxed);
+        } else {
+            // 切断中のものはバックログへ回し、キューを詰まらせない
+            if (result != PublishResult::ConnectionLost ||
+                !deferPublish(slot->uri, slot->payload, slot->payloadLen,
+                              slot->chunkNum, slot->cacheTimeSec, slot->expirySec,
+                              slot->endChunkNum)) {
+                publisher.failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(publisher.mutex);
+        publisher.head = (publisher.head + 1) % kPublishQueueSize;
+        publisher.count--;
+    }
+}
+
+void CeforeInterface::reconnectPublisher(Publisher& publisher) {
+    uint64_t now_ms = steadyMs();
+    if (!publisher.backoff.due(now_ms)) {
+        return;
+    }
+
+    CefT_Client_Handle old_handle = publisher.handle.exchange(-1);
+    if (old_handle >= 1) {
+        cef_client_close(old_handle);
+    }
+    CefT_Client_Handle handle = connectHandle(nullptr);
+    publisher.handle = handle;
+
+    if (handle < 1) {
+        publisher.backoff.failed(now_ms);
+        return;
+    }
+
+    publisher.backoff.reset();
+    publisher.connected = true;
+    publisher.reconnects.fetch_add(1, std::memory_order_relaxed);
+    std::cout << "Publisher reconnected to cefnetd (handle=" << handle << ")" << std::endl;
+}
+
+void CeforeInterface::reportPublishers(std::ostream& os) const {
+    for (size_t i = 0; i < publishers_.size(); i++) {
+        const Publisher& publisher = *publishers_[i];
+        os << "[publisher " << i << "] handle=" << publisher.handle.load()
+           << " published=" << publisher.published.load(std::memory_order_relaxed)
+           << " bytes=" << publisher.bytes.load(std::memory_order_relaxed)
+           << " failed=" << publisher.failed.load(std::memory_order_relaxed)
+           << " dropped=" << publisher.dropped.load(std::memory_order_relaxed)
+           << " backlog_refused=" << publisher.refused.load(std::memory_order_relaxed)
+           << " reconnects=" << publisher.reconnects.load(std::memory_order_relaxed) << std::endl;
+    }
+}
+
 void CeforeInterface::startReceiving() {
     if (running_) {
         return;
@@ -132,26 +562,80 @@ void CeforeInterface::setInterestCallback(std::function<void(const std::string&,
 }
 
 void CeforeInterface::receiveLoop() {
+    Realtime::applyToCurrentThread(realtime_, GatewayThread::CeforeRx);
+
     unsigned char recv_buff[CefC_Max_Length];
-    struct cef_app_request app_request;
 
     while (running_) {
-        int len = cef_client_read(handle_, recv_buff, CefC_Max_Length);
-
-        if (len > 0) {
-            int res = cef_client_request_get_with_info(recv_buff, len, &app_request);
+        readOnce(recv_buff, sizeof(recv_buff));
+
+        if (realtime_.enabled) {
+            // 1msスリープの寝過ごし量を起床遅延として記録
+            uint64_t before = JitterProbe::nowNs();
+            usleep(1000);
+            uint64_t slept = JitterProbe::nowNs() - before;
+            rx_jitter_.record(slept > 1000000 ? slept - 1000000 : 0);
+        } else {
+            usleep(1000); // 1msポーリング
+        }
+    }
+}
 
-            if (res > 0 && app_request.version == CefC_App_Version) {
-                char uri[1024];
-                cef_frame_conversion_name_to_uri(app_request.name, app_request.name_len, uri);
-                uint32_t chunk_num = app_request.chunk_num;
+void CeforeInterface::handleReadable() {
+    readOnce(event_buff_, sizeof(event_buff_));
+}
 
-                if (interest_callback_) {
-                    interest_callback_(std::string(uri), chunk_num);
-                }
-            }
+bool CeforeInterface::readOnce(unsigned char* buffer, size_t size) {
+    struct cef_app_request app_request;
+    CefT_Client_Handle handle;
+    uint64_t generation;
+
+    // 読み込み（タイムアウトまで待つ）の間はロックを持たず、公開や再接続を止めない
+    {
+        std::lock_guard<std::mutex> lock(handle_mutex_);
+        if (!connected_ || handle_ < 1) {
+            return false;
+        }
+        handle = handle_;
+        generation = handle_generation_;
+        reading_handle_ = handle;
+    }
+    int len = cef_client_read(handle, buffer, static_cast<int>(size));
+    bool stale;
+    {
+        std::lock_guard<std::mutex> lock(handle_mutex_);
+        reading_handle_ = -1;
+        if (retired_handle_ >= 1) {
+            cef_client_close(retired_handle_);
+            retired_handle_ = -1;
+        }
+        stale = generation != handle_generation_;
+    }
+    if (len < 0) {
+        // 読み込み中に張り直した古いハンドルのエラーは新しい接続の切断ではない
+        if (!stale) {
+            markDisconnected();
         }
+        return false;
+    }
+    if (len == 0) {
+        return false;
+    }
+    PacketTracer::begin(TracePath::Downlink);
+
+    int res = cef_client_request_get_with_info(buffer, len, &app_request);
 
-        usleep(1000); // 1msポーリング
+    if (res > 0 && app_request.version == CefC_App_Version) {
+        char uri[1024];
+        cef_frame_conversion_name_to_uri(app_request.name, app_request.name_len, uri);
+        uint32_t chunk_num = app_request.chunk_num;
+        PacketTracer::mark(TraceStage::Decoded);
+
+        if (interest_callback_) {
+            interest_callback_(std::string(uri), chunk_num);
+        }
     }
+    PacketTracer::setCurrentId(0);
+
+    return true;
 }
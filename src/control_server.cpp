@@ -0,0 +1,204 @@
+#include "control_server.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+ControlServer::ControlServer(const std::string& path) : path_(path), listen_fd_(-1) {}
+
+ControlServer::~ControlServer() {
+    for (Client& client : clients_) {
+        closeClient(client);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+}
+
+bool ControlServer::open() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Control socket path too long: " << path_ << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, path_.c_str(), path_.size());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "Error creating control socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 前回異常終了したときのソケットファイルが残っていれば置き換える
+    unlink(path_.c_str());
+
+    // FIBの内容や設定を変更できるため所有者のみ接続可能にする
+    mode_t old_mask = umask(0077);
+    int rc = bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+
+    if (rc < 0 || listen(listen_fd_, static_cast<int>(kMaxClients)) < 0) {
+        std::cerr << "Error binding control socket " << path_ << ": " << strerror(errno) << std::endl;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    addCommand("help", "", [this](const Args&, std::ostream& out) {
+        for (const auto& entry : commands_) {
+            out << entry.first;
+            if (!entry.second.usage.empty()) {
+                out << " " << entry.second.usage;
+            }
+            out << "\n";
+        }
+        out << "quit\n";
+        return true;
+    });
+
+    std::cout << "Control socket listening on " << path_ << std::endl;
+    return true;
+}
+
+void ControlServer::addCommand(const std::string& name, const std::string& usage, Handler handler) {
+    commands_[name] = Command{usage, std::move(handler)};
+}
+
+void ControlServer::poll() {
+    if (listen_fd_ < 0) {
+        return;
+    }
+
+    acceptClients();
+
+    for (Client& client : clients_) {
+        if (client.fd >= 0 && !serviceClient(client)) {
+            closeClient(client);
+        }
+    }
+}
+
+void ControlServer::acceptClients() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Control socket accept error: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        Client* slot = nullptr;
+        for (Client& client : clients_) {
+            if (client.fd < 0) {
+                slot = &client;
+                break;
+            }
+        }
+        if (!slot) {
+            static const char busy[] = "ERR too many control connections\n";
+            send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+
+        slot->fd = fd;
+        slot->len = 0;
+    }
+}
+
+bool ControlServer::serviceClient(Client& client) {
+    while (true) {
+        ssize_t n = recv(client.fd, client.line + client.len, sizeof(client.line) - client.len, 0);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        client.len += static_cast<size_t>(n);
+
+        // 届いている行をすべて実行する
+        size_t start = 0;
+        while (true) {
+            char* newline = static_cast<char*>(memchr(client.line + start, '\n', client.len - start));
+            if (!newline) {
+                break;
+            }
+            std::string_view line(client.line + start, newline - (client.line + start));
+            start = newline - client.line + 1;
+
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line == "quit") {
+                return false;
+            }
+
+            std::string reply;
+            bool ok = execute(line, reply);
+            reply += ok ? "OK\n" : "ERR\n";
+
+            // 応答はソケットバッファに収まる大きさ（書けなければ接続を切る）
+            ssize_t sent = send(client.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+            if (sent != static_cast<ssize_t>(reply.size())) {
+                return false;
+            }
+        }
+
+        memmove(client.line, client.line + start, client.len - start);
+        client.len -= start;
+        if (client.len == sizeof(client.line)) {
+            static const char too_long[] = "ERR line too long\n";
+            send(client.fd, too_long, sizeof(too_long) - 1, MSG_NOSIGNAL);
+            return false;
+        }
+    }
+}
+
+bool ControlServer::execute(std::string_view line, std::string& reply) {
+    // 空白区切りで分割（先頭がコマンド名）
+    Args args;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        size_t start = line.find_first_not_of(" \t", pos);
+        if (start == std::string_view::npos) {
+            break;
+        }
+        size_t end = line.find_first_of(" \t", start);
+        if (end == std::string_view::npos) {
+            end = line.size();
+        }
+        args.push_back(line.substr(start, end - start));
+        pos = end;
+    }
+    if (args.empty()) {
+        return true;
+    }
+
+    auto it = commands_.find(std::string(args[0]));
+    if (it == commands_.end()) {
+        reply = "unknown command: " + std::string(args[0]) + " (try help)\n";
+        return false;
+    }
+
+    std::ostringstream out;
+    bool ok = it->second.handler(args, out);
+    reply = out.str();
+    return ok;
+}
+
+void ControlServer::closeClient(Client& client) {
+    if (client.fd >= 0) {
+        close(client.fd);
+        client.fd = -1;
+    }
+    client.len = 0;
+}
@@ -0,0 +1,83 @@
+#include "duplicate_filter.h"
+#include "gateway_clock.h"
+#include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+
+static_assert((DuplicateFilter::kTableSize & (DuplicateFilter::kTableSize - 1)) == 0,
+              "kTableSize must be a power of two");
+
+DuplicateFilter::DuplicateFilter(uint32_t window_ms) : windowMs_(window_ms) {}
+
+uint64_t DuplicateFilter::nowMs() {
+    // --replay中は記録時刻で判定する
+    return GatewayClock::nowMs();
+}
+
+DuplicateFilter::Result DuplicateFilter::check(std::string_view content_name,
+                                               const uint8_t* content, size_t len,
+                                               uint8_t hop_count,
+                                               const MacAddress& sender_mac,
+                                               MacAddress* previous_mac) {
+    CacheKeyHasher hasher;
+    uint64_t key = CacheKeyHasher::mix(
+        hasher(content_name) ^
+        (hasher(std::string_view(reinterpret_cast<const char*>(content), len)) * 0x9E3779B97F4A7C15ULL));
+    if (key == 0) {
+        key = 1;
+    }
+    return checkAt(key, hop_count, sender_mac, nowMs(), previous_mac);
+}
+
+void DuplicateFilter::report(std::ostream& os) const {
+    os << "[dedup] passed=" << stats_.passed.load(std::memory_order_relaxed)
+       << " suppressed=" << stats_.suppressed.load(std::memory_order_relaxed)
+       << " better_path=" << stats_.better_path.load(std::memory_order_relaxed)
+       << " evicted=" << stats_.evicted.load(std::memory_order_relaxed) << "\n";
+}
+
+DuplicateFilter::Result DuplicateFilter::checkAt(uint64_t key, uint8_t hop_count,
+                                                 const MacAddress& sender_mac, uint64_t now_ms,
+                                                 MacAddress* previous_mac) {
+    // 同じキーか、空き・期限切れのスロットを短い範囲で探す
+    // どちらもなければ範囲内で最も古いものを上書きする
+    Entry* free_slot = nullptr;
+    Entry* oldest = nullptr;
+
+    for (size_t i = 0; i < kMaxProbe; i++) {
+        Entry& entry = table_[(key + i) & (kTableSize - 1)];
+        bool expired = entry.key == 0 || now_ms - entry.firstSeenMs >= windowMs_;
+
+        if (!expired && entry.key == key) {
+            if (hop_count < entry.bestHop) {
+                if (previous_mac) {
+                    *previous_mac = entry.bestMac;
+                }
+                entry.bestHop = hop_count;
+                entry.bestMac = sender_mac;
+                stats_.better_path++;
+                return Result::BetterPath;
+            }
+            stats_.suppressed++;
+            return Result::Duplicate;
+        }
+
+        if (expired) {
+            if (!free_slot) {
+                free_slot = &entry;
+            }
+        } else if (!oldest || entry.firstSeenMs < oldest->firstSeenMs) {
+            oldest = &entry;
+        }
+    }
+
+    Entry* slot = free_slot;
+    if (!slot) {
+        slot = oldest;
+        stats_.evicted++;
+    }
+    slot->key = key;
+    slot->firstSeenMs = now_ms;
+    slot->bestHop = hop_count;
+    slot->bestMac = sender_mac;
+    stats_.passed++;
+    return Result::First;
+}
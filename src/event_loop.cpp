@@ -0,0 +1,136 @@
+#include "event_loop.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+EventLoop::EventLoop() : epoll_fd_(-1), running_(false) {}
+
+EventLoop::~EventLoop() {
+    for (int fd : owned_fds_) {
+        close(fd);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+bool EventLoop::init() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        std::cerr << "epoll_create1 failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::addFd(int fd, Handler handler) {
+    return watch(fd, std::move(handler), false);
+}
+
+void EventLoop::removeFd(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+}
+
+bool EventLoop::addTimer(uint32_t interval_ms, Handler handler) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "timerfd_create failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(fd, 0, &spec, nullptr) != 0) {
+        std::cerr << "timerfd_settime failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    return watch(fd, [fd, handler]() {
+        // 満了回数を読み捨てる（遅れても1回だけ処理する）
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            handler();
+        }
+    }, true);
+}
+
+bool EventLoop::addSignals(const sigset_t& signals, std::function<void(int)> handler) {
+    int fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "signalfd failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return watch(fd, [fd, handler]() {
+        struct signalfd_siginfo info;
+        while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+            handler(static_cast<int>(info.ssi_signo));
+        }
+    }, true);
+}
+
+bool EventLoop::watch(int fd, Handler handler, bool owned) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        std::cerr << "epoll_ctl(ADD, " << fd << ") failed: " << strerror(errno) << std::endl;
+        if (owned) {
+            close(fd);
+        }
+        return false;
+    }
+
+    handlers_[fd] = std::move(handler);
+    if (owned) {
+        owned_fds_.push_back(fd);
+    }
+    return true;
+}
+
+void EventLoop::run() {
+    static constexpr int kMaxEvents = 16;
+    struct epoll_event events[kMaxEvents];
+
+    running_ = true;
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n && running_; i++) {
+            int fd = events[i].data.fd;
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end()) {
+                continue;
+            }
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                // 切断されたfdは監視から外す（読み残しは最後に処理）
+                std::cerr << "fd " << fd << " closed or failed, removing from event loop" << std::endl;
+                Handler handler = it->second;
+                removeFd(fd);
+                handler();
+                continue;
+            }
+
+            it->second();
+        }
+    }
+}
@@ -0,0 +1,620 @@
+#include "fib_replicator.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+
+// データグラムの種類
+enum ReplicaType : uint8_t {
+    kReplicaDelta = 1,      // 自分の更新（seqから連続番号）
+    kReplicaSnapshot = 2,   // FIB全体（seq: 作成時点の更新番号、part: 何番目のデータグラムか、最後にkReplicaLast）
+    kReplicaDigest = 3,     // バージョンベクタ（seq: 送信元の最新の更新番号）
+};
+
+static constexpr uint8_t kReplicaLast = 0x01;
+static constexpr uint8_t kReplicaVersion = 2;
+static constexpr uint16_t kReplicaMagic = 0x5246;   // "FR"
+// 抜けを検出してダイジェストを返す最小間隔（ピアごと）
+static constexpr uint64_t kPullIntervalMs = 100;
+
+// データグラムのヘッダ（同じアーキテクチャ同士で使うためホストバイトオーダー）
+struct __attribute__((packed)) ReplicaHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint32_t origin;
+    uint32_t seq;
+    uint16_t count;
+    uint8_t flags;
+    uint8_t part;
+};
+
+// FIB全体が1回のスナップショットのデータグラム番号（part）に収まること
+static_assert(GatewayFIB::kCapacity * GatewayFIB::kMaxNextHops /
+                  ((FibReplicator::kMaxDatagram - sizeof(ReplicaHeader)) / (8 + FibReplicator::kMaxNameSize)) <
+              FibReplicator::kMaxSnapshotParts,
+              "snapshot does not fit in kMaxSnapshotParts datagrams");
+
+// 経路レコード: MAC(6) + 直前の名前と共通する先頭の長さ(1) + 残りの長さ(1) + 残り
+// ダイジェストのレコード: ノードID(4) + 適用済み番号(4)
+struct __attribute__((packed)) VectorRecord {
+    uint32_t node;
+    uint32_t seq;
+};
+
+// 1データグラム分を組み立てる
+struct ReplicaWriter {
+    uint8_t buf[FibReplicator::kMaxDatagram];
+    size_t len = 0;
+    uint16_t count = 0;
+    char prev[FibReplicator::kMaxNameSize];
+    size_t prevLen = 0;
+
+    void begin(uint8_t type, uint32_t origin, uint32_t seq) {
+        ReplicaHeader header{};
+        header.magic = kReplicaMagic;
+        header.version = kReplicaVersion;
+        header.type = type;
+        header.origin = origin;
+        header.seq = seq;
+        memcpy(buf, &header, sizeof(header));
+        len = sizeof(header);
+        count = 0;
+        prevLen = 0;
+    }
+
+    // 入りきらなければfalse
+    bool addRoute(std::string_view name, const MacAddress& mac) {
+        size_t shared = 0;
+        while (shared < prevLen && shared < name.size() && prev[shared] == name[shared]) {
+            shared++;
+        }
+        size_t suffix = name.size() - shared;
+        if (len + 8 + suffix > sizeof(buf)) {
+            return false;
+        }
+
+        memcpy(buf + len, mac.bytes, 6);
+        buf[len + 6] = static_cast<uint8_t>(shared);
+        buf[len + 7] = static_cast<uint8_t>(suffix);
+        memcpy(buf + len + 8, name.data() + shared, suffix);
+        len += 8 + suffix;
+
+        memcpy(prev, name.data(), name.size());
+        prevLen = name.size();
+        count++;
+        return true;
+    }
+
+    bool addVector(uint32_t node, uint32_t seq) {
+        if (len + sizeof(VectorRecord) > sizeof(buf)) {
+            return false;
+        }
+        VectorRecord record{node, seq};
+        memcpy(buf + len, &record, sizeof(record));
+        len += sizeof(record);
+        count++;
+        return true;
+    }
+
+    size_t finish(uint8_t flags, uint8_t part = 0) {
+        ReplicaHeader header;
+        memcpy(&header, buf, sizeof(header));
+        header.count = count;
+        header.flags = flags;
+        header.part = part;
+        memcpy(buf, &header, sizeof(header));
+        return len;
+    }
+};
+
+FibReplicator::FibReplicator(GatewayFIB& fib, const ReplicationConfig& config)
+    : fib_(fib), config_(config), fd_(-1), multicast_(false), running_(false),
+      seq_(0), last_digest_ms_(0) {
+    // 再起動したノードは別ノードとして扱われる（相手は新しいIDにスナップショットを送る）
+    std::random_device rd;
+    do {
+        node_id_ = rd();
+    } while (node_id_ == 0);
+}
+
+FibReplicator::~FibReplicator() {
+    stop();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+uint64_t FibReplicator::nowMs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+bool FibReplicator::parseAddress(const std::string& text, uint16_t default_port, sockaddr_in& out) {
+    memset(&out, 0, sizeof(out));
+    out.sin_family = AF_INET;
+    out.sin_port = htons(default_port);
+
+    std::string host = text;
+    size_t colon = text.rfind(':');
+    if (colon != std::string::npos) {
+        host = text.substr(0, colon);
+        try {
+            size_t used = 0;
+            unsigned long port = std::stoul(text.substr(colon + 1), &used);
+            if (used != text.size() - colon - 1 || port == 0 || port > 65535) {
+                return false;
+            }
+            out.sin_port = htons(static_cast<uint16_t>(port));
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return inet_pton(AF_INET, host.c_str(), &out.sin_addr) == 1;
+}
+
+bool FibReplicator::open() {
+    // 送信先: ピア指定があればユニキャスト、なければマルチキャストグループ
+    for (const auto& peer : config_.peers) {
+        sockaddr_in addr;
+        if (!parseAddress(peer, config_.port, addr)) {
+            std::cerr << "Invalid replication peer: " << peer << std::endl;
+            return false;
+        }
+        destinations_.push_back(addr);
+    }
+    if (destinations_.empty()) {
+        sockaddr_in group;
+        if (!parseAddress(config_.group, config_.port, group) ||
+            !IN_MULTICAST(ntohl(group.sin_addr.s_addr))) {
+            std::cerr << "Invalid replication group: " << config_.group << std::endl;
+            return false;
+        }
+        destinations_.push_back(group);
+        multicast_ = true;
+    }
+
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        std::cerr << "Error creating replication socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    int on = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(config_.port);
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        std::cerr << "Error binding replication port " << config_.port << ": " << strerror(errno) << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    if (multicast_) {
+        ip_mreq mreq;
+        mreq.imr_multiaddr = destinations_[0].sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            std::cerr << "Error joining replication group " << config_.group << ": " << strerror(errno) << std::endl;
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        // 同じホストの別インスタンスにも届くようにループバックを有効にする（自分の分は送信元IDで捨てる）
+        unsigned char ttl = 1;
+        unsigned char loop = 1;
+        setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    }
+
+    std::cout << "FIB replication node " << std::hex << node_id_ << std::dec
+              << " on port " << config_.port << (multicast_ ? " (multicast " + config_.group + ")" : "")
+              << std::endl;
+
+    // 起動直後にダイジェストを送り、既存ノードからFIB全体を受け取る
+    sendDigest(nullptr);
+    return true;
+}
+
+void FibReplicator::start() {
+    if (fd_ < 0 || running_) {
+        return;
+    }
+    running_ = true;
+    recv_thread_ = std::thread(&FibReplicator::receiveLoop, this);
+}
+
+void FibReplicator::stop() {
+    running_ = false;
+    if (recv_thread_.joinable()) {
+        recv_thread_.join();
+    }
+}
+
+void FibReplicator::receiveLoop() {
+    while (running_) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 100) > 0) {
+            handleReadable();
+        }
+    }
+}
+
+void FibReplicator::handleReadable() {
+    uint8_t buf[kMaxDatagram];
+
+    while (true) {
+        sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Replication receive error: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        handleDatagram(buf, static_cast<size_t>(n), from);
+    }
+}
+
+void FibReplicator::handleDatagram(const uint8_t* data, size_t len, const sockaddr_in& from) {
+    ReplicaHeader header;
+    if (len < sizeof(header)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.rejected++;
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != kReplicaMagic || header.version != kReplicaVersion || header.origin == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.rejected++;
+        return;
+    }
+    // マルチキャストのループバックで戻ってきた自分の送信
+    if (header.origin == node_id_) {
+        return;
+    }
+
+    data += sizeof(header);
+    len -= sizeof(header);
+
+    switch (header.type) {
+    case kReplicaDelta:
+    case kReplicaSnapshot:
+        applyRoutes(data, len, header.type, header.origin, header.seq, header.count, header.flags,
+                    header.part, from);
+        break;
+    case kReplicaDigest:
+        applyDigest(data, len, header.origin, header.seq, header.count, from);
+        break;
+    default: {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.rejected++;
+        break;
+    }
+    }
+}
+
+FibReplicator::Node* FibReplicator::touchNode(uint32_t id, const sockaddr_in& from, uint64_t now_ms) {
+    // mutex_を保持して呼ぶこと
+    Node* empty = nullptr;
+    Node* oldest = &nodes_[0];
+    for (Node& node : nodes_) {
+        if (node.id == id) {
+            node.lastHeardMs = now_ms;
+            node.addr = from;
+            return &node;
+        }
+        if (node.id == 0 && !empty) {
+            empty = &node;
+        }
+        if (node.lastHeardMs < oldest->lastHeardMs) {
+            oldest = &node;
+        }
+    }
+
+    // 新しいノード（満杯なら最も長く聞こえていないノードを忘れる）
+    Node* node = empty ? empty : oldest;
+    *node = Node{};
+    node->id = id;
+    node->lastHeardMs = now_ms;
+    node->addr = from;
+
+    char addr[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, addr, sizeof(addr));
+    std::cout << "FIB replication peer " << std::hex << id << std::dec
+              << " at " << addr << ":" << ntohs(from.sin_port) << std::endl;
+    return node;
+}
+
+void FibReplicator::applyRoutes(const uint8_t* data, size_t len, uint8_t type, uint32_t origin,
+                                uint32_t seq, uint16_t count, uint8_t flags, uint8_t part,
+                                const sockaddr_in& from) {
+    uint64_t now_ms = nowMs();
+    uint32_t applied;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        applied = touchNode(origin, from, now_ms)->applied;
+    }
+
+    // 名前は直前のレコードとの差分で届くので順に復元する
+    char name[kMaxNameSize];
+    size_t name_len = 0;
+    size_t pos = 0;
+    uint64_t learned = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (pos + 8 > len) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.rejected++;
+            return;
+        }
+        MacAddress mac;
+        memcpy(mac.bytes, data + pos, 6);
+        size_t shared = data[pos + 6];
+        size_t suffix = data[pos + 7];
+        if (shared > name_len || shared + suffix > kMaxNameSize || pos + 8 + suffix > len) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.rejected++;
+            return;
+        }
+        memcpy(name + shared, data + pos + 8, suffix);
+        name_len = shared + suffix;
+        pos += 8 + suffix;
+
+        // 適用済みの差分は飛ばす（学習は冪等なので、スナップショットは常に適用する）
+        if (type == kReplicaDelta && seq + i <= applied) {
+            continue;
+        }
+        fib_.learn(std::string_view(name, name_len), mac);
+        learned++;
+    }
+
+    bool pull = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.applied += learned;
+
+        Node* node = touchNode(origin, from, now_ms);
+        if (type == kReplicaDelta && count > 0) {
+            if (seq <= node->applied + 1) {
+                node->applied = std::max<uint32_t>(node->applied, seq + count - 1);
+            } else if (now_ms - node->lastPullMs >= kPullIntervalMs) {
+                // 途中の更新が抜けている: 適用はしたが番号は進めず、すぐにダイジェストを返して再送を促す
+                stats_.gaps++;
+                node->lastPullMs = now_ms;
+                pull = true;
+            } else {
+                stats_.gaps++;
+            }
+        } else if (type == kReplicaSnapshot) {
+            // すべてのデータグラムが揃ったときだけ番号を進める（欠けていればダイジェストで再送を促す）
+            if (node->snapshotSeq != seq) {
+                node->snapshotSeq = seq;
+                node->snapshotTotal = 0;
+                node->snapshotParts.reset();
+            }
+            node->snapshotParts.set(part);
+            if (flags & kReplicaLast) {
+                node->snapshotTotal = static_cast<uint16_t>(part) + 1;
+            }
+            if (node->snapshotTotal != 0 && node->snapshotParts.count() == node->snapshotTotal) {
+                node->applied = std::max(node->applied, seq);
+                node->snapshotTotal = 0;
+                node->snapshotParts.reset();
+            } else if ((flags & kReplicaLast) && seq > node->applied) {
+                stats_.gaps++;
+                if (now_ms - node->lastPullMs >= kPullIntervalMs) {
+                    node->lastPullMs = now_ms;
+                    pull = true;
+                }
+            }
+        }
+    }
+
+    if (pull) {
+        sendDigest(&from);
+    }
+}
+
+void FibReplicator::applyDigest(const uint8_t* data, size_t len, uint32_t origin, uint32_t seq,
+                                uint16_t count, const sockaddr_in& from) {
+    if (len < static_cast<size_t>(count) * sizeof(VectorRecord)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.rejected++;
+        return;
+    }
+
+    // 相手が適用済みの自分の更新番号（載っていなければ0: まだ何も受け取っていない）
+    uint32_t peer_has = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        VectorRecord record;
+        memcpy(&record, data + i * sizeof(record), sizeof(record));
+        if (record.node == node_id_) {
+            peer_has = record.seq;
+        }
+    }
+
+    uint64_t now_ms = nowMs();
+    bool behind = false;
+    uint32_t my_seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Node* node = touchNode(origin, from, now_ms);
+        my_seq = seq_;
+        // 相手の更新を取りこぼしている: こちらのダイジェストを返して再送させる
+        if (seq > node->applied && now_ms - node->lastPullMs >= kPullIntervalMs) {
+            node->lastPullMs = now_ms;
+            behind = true;
+        }
+    }
+
+    if (peer_has < my_seq) {
+        resend(from, peer_has);
+    }
+    if (behind) {
+        sendDigest(&from);
+    }
+}
+
+void FibReplicator::announce(std::string_view content_name, const MacAddress& mac) {
+    if (fd_ < 0 || content_name.size() > kMaxNameSize) {
+        return;
+    }
+
+    ReplicaWriter writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint32_t seq = ++seq_;
+
+        LogEntry& entry = log_[seq % kLogSize];
+        entry.seq = seq;
+        entry.mac = mac;
+        entry.nameLen = static_cast<uint8_t>(content_name.size());
+        memcpy(entry.name, content_name.data(), content_name.size());
+
+        writer.begin(kReplicaDelta, node_id_, seq);
+        writer.addRoute(content_name, mac);
+        writer.finish(0);
+        stats_.announced++;
+    }
+    sendTo(writer.buf, writer.len, nullptr);
+}
+
+void FibReplicator::tick(uint64_t now_ms) {
+    if (fd_ < 0) {
+        return;
+    }
+
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        due = now_ms - last_digest_ms_ >= config_.sync_interval_ms;
+
+        for (Node& node : nodes_) {
+            if (node.id != 0 && now_ms - node.lastHeardMs >= kNodeTimeoutMs) {
+                std::cout << "FIB replication peer " << std::hex << node.id << std::dec
+                          << " timed out" << std::endl;
+                node = Node{};
+            }
+        }
+    }
+
+    if (due) {
+        sendDigest(nullptr);
+    }
+}
+
+void FibReplicator::sendDigest(const sockaddr_in* to) {
+    ReplicaWriter writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writer.begin(kReplicaDigest, node_id_, seq_);
+        for (const Node& node : nodes_) {
+            if (node.id != 0) {
+                writer.addVector(node.id, node.applied);
+            }
+        }
+        writer.finish(0);
+        if (!to) {
+            last_digest_ms_ = nowMs();
+        }
+    }
+    sendTo(writer.buf, writer.len, to);
+}
+
+void FibReplicator::resend(const sockaddr_in& to, uint32_t from_seq) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // 履歴に残っていない分があればFIB全体を送る
+    if (seq_ - from_seq > kLogSize) {
+        lock.unlock();
+        sendSnapshot(to);
+        return;
+    }
+
+    ReplicaWriter writer;
+    uint32_t seq = from_seq + 1;
+    while (seq <= seq_) {
+        writer.begin(kReplicaDelta, node_id_, seq);
+        while (seq <= seq_) {
+            const LogEntry& entry = log_[seq % kLogSize];
+            if (!writer.addRoute(std::string_view(entry.name, entry.nameLen), entry.mac)) {
+                break;
+            }
+            seq++;
+        }
+        stats_.resent += writer.count;
+        writer.finish(0);
+        sendTo(writer.buf, writer.len, &to);
+    }
+}
+
+void FibReplicator::sendSnapshot(const sockaddr_in& to) {
+    uint32_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seq = seq_;
+        stats_.snapshots++;
+    }
+
+    // FIBのロック中は送信せず、経路を写してから送る
+    std::vector<Route> routes;
+    fib_.forEachRoute([&routes](std::string_view name, const MacAddress& mac) {
+        if (name.size() <= kMaxNameSize) {
+            routes.push_back(Route{std::string(name), mac});
+        }
+    });
+
+    ReplicaWriter writer;
+    size_t i = 0;
+    size_t part = 0;
+    do {
+        writer.begin(kReplicaSnapshot, node_id_, seq);
+        while (i < routes.size() && writer.addRoute(routes[i].name, routes[i].mac)) {
+            i++;
+        }
+        writer.finish(i == routes.size() ? kReplicaLast : 0, static_cast<uint8_t>(part++));
+        sendTo(writer.buf, writer.len, &to);
+    } while (i < routes.size());
+}
+
+void FibReplicator::sendTo(const uint8_t* data, size_t len, const sockaddr_in* to) {
+    if (to) {
+        sendto(fd_, data, len, 0, reinterpret_cast<const sockaddr*>(to), sizeof(*to));
+        return;
+    }
+    for (const auto& dest : destinations_) {
+        sendto(fd_, data, len, 0, reinterpret_cast<const sockaddr*>(&dest), sizeof(dest));
+    }
+}
+
+FibReplicator::Stats FibReplicator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FibReplicator::report(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "[replica] node=" << std::hex << node_id_ << std::dec << " seq=" << seq_
+       << " announced=" << stats_.announced << " applied=" << stats_.applied
+       << " gaps=" << stats_.gaps << " resent=" << stats_.resent
+       << " snapshots=" << stats_.snapshots << " rejected=" << stats_.rejected << std::endl;
+    for (const Node& node : nodes_) {
+        if (node.id != 0) {
+            os << "[replica]   peer=" << std::hex << node.id << std::dec
+               << " applied=" << node.applied << std::endl;
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include "fragment_reassembler.h"
+#include "gateway_clock.h"
+#include <cstring>
+
+static_assert(FragmentReassembler::kMaxFragments <= 32,
+              "receivedMask must hold one bit per fragment");
+
+FragmentReassembler::FragmentReassembler(uint32_t timeout_ms) : timeoutMs_(timeout_ms) {}
+
+uint64_t FragmentReassembler::getCurrentTimeMs() {
+    // タイムアウト判定用のため単調時計を使う（--replay中は記録時刻）
+    return GatewayClock::nowMs();
+}
+
+bool FragmentReassembler::addFragment(const MacAddress& sender_mac,
+                                      const IcsnPacketView& fragment,
+                                      std::string& content_name,
+                                      std::vector<uint8_t>& payload) {
+    if (fragment.signal() != IcsnSignal::Fragment ||
+        fragment.content().size() > IcsnPacketView::kMaxFragmentData ||
+        fragment.fragmentCount() == 0 ||
+        fragment.fragmentCount() > kMaxFragments ||
+        fragment.fragmentIndex() >= fragment.fragmentCount() ||
+        fragment.contentName().size() > sizeof(Slot::name)) {
+        stats_.rejected++;
+        return false;
+    }
+
+    uint64_t now_ms = getCurrentTimeMs();
+    expireAt(now_ms);
+
+    Slot* slot = findSlot(sender_mac, fragment.messageId());
+
+    // 同じIDで総数が変わった場合は送信元が再起動したとみなして作り直す
+    if (slot && slot->fragmentCount != fragment.fragmentCount()) {
+        slot->inUse = false;
+        slot = nullptr;
+    }
+
+    // 名前が食い違うフラグメントは別メッセージと混ざっている（IDの衝突・破損）ので丸ごと捨てる
+    if (slot && slot->nameView() != fragment.contentName()) {
+        slot->inUse = false;
+        stats_.mismatched++;
+        return false;
+    }
+
+    if (!slot) {
+        slot = allocateSlot();
+        slot->inUse = true;
+        slot->senderMac = sender_mac;
+        slot->messageId = fragment.messageId();
+        slot->fragmentCount = fragment.fragmentCount();
+        slot->receivedCount = 0;
+        slot->receivedMask = 0;
+        slot->nameLen = static_cast<uint8_t>(fragment.contentName().size());
+        memcpy(slot->name, fragment.contentName().data(), slot->nameLen);
+    }
+
+    uint32_t bit = 1u << fragment.fragmentIndex();
+    if (slot->receivedMask & bit) {
+        stats_.duplicates++;
+        slot->lastUpdateMs = now_ms;
+        return false;
+    }
+
+    // フラグメントはインデックス位置に格納し、完成時に詰める
+    memcpy(slot->data + fragment.fragmentIndex() * IcsnPacketView::kMaxFragmentData,
+           fragment.contentData(), fragment.content().size());
+    slot->fragmentLen[fragment.fragmentIndex()] = static_cast<uint8_t>(fragment.content().size());
+    slot->receivedMask |= bit;
+    slot->receivedCount++;
+    slot->lastUpdateMs = now_ms;
+
+    if (slot->receivedCount < slot->fragmentCount) {
+        return false;
+    }
+
+    // 全フラグメント受信完了
+    payload.clear();
+    for (uint8_t i = 0; i < slot->fragmentCount; i++) {
+        const uint8_t* src = slot->data + i * IcsnPacketView::kMaxFragmentData;
+        payload.insert(payload.end(), src, src + slot->fragmentLen[i]);
+    }
+    content_name.assign(slot->nameView());
+
+    slot->inUse = false;
+    stats_.completed++;
+    return true;
+}
+
+void FragmentReassembler::report(std::ostream& os) const {
+    os << "[reassembly] completed=" << stats_.completed.load(std::memory_order_relaxed)
+       << " timed_out=" << stats_.timed_out.load(std::memory_order_relaxed)
+       << " evicted=" << stats_.evicted.load(std::memory_order_relaxed)
+       << " rejected=" << stats_.rejected.load(std::memory_order_relaxed)
+       << " duplicates=" << stats_.duplicates.load(std::memory_order_relaxed)
+       << " mismatched=" << stats_.mismatched.load(std::memory_order_relaxed) << "\n";
+}
+
+size_t FragmentReassembler::expire() {
+    return expireAt(getCurrentTimeMs());
+}
+
+size_t FragmentReassembler::expireAt(uint64_t now_ms) {
+    size_t expired = 0;
+    for (auto& slot : slots_) {
+        if (slot.inUse && now_ms - slot.lastUpdateMs >= timeoutMs_) {
+            slot.inUse = false;
+            expired++;
+        }
+    }
+    stats_.timed_out += expired;
+    return expired;
+}
+
+FragmentReassembler::Slot* FragmentReassembler::findSlot(const MacAddress& sender_mac,
+                                                         uint16_t message_id) {
+    for (auto& slot : slots_) {
+        if (slot.inUse && slot.messageId == message_id && slot.senderMac == sender_mac) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+FragmentReassembler::Slot* FragmentReassembler::allocateSlot() {
+    Slot* oldest = nullptr;
+    for (auto& slot : slots_) {
+        if (!slot.inUse) {
+            return &slot;
+        }
+        if (!oldest || slot.lastUpdateMs < oldest->lastUpdateMs) {
+            oldest = &slot;
+        }
+    }
+
+    // 空きがなければ最も古いメッセージを破棄
+    oldest->inUse = false;
+    stats_.evicted++;
+    return oldest;
+}
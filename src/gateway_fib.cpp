@@ -1,100 +1,383 @@
 #include "gateway_fib.h"
-#include <sstream>
-#include <vector>
+#include "gateway_clock.h"
+#include <algorithm>
 
-GatewayFIB::GatewayFIB(int max_virtual_depth) : maxVirtualDepth_(max_virtual_depth) {}
+GatewayFIB::GatewayFIB(int max_virtual_depth, int aggregate_depth)
+    : maxVirtualDepth_(max_virtual_depth), aggregateDepth_(aggregate_depth), filterEnabled_(true) {}
+
+uint64_t GatewayFIB::nowMs() {
+    // --replay中は記録時刻で判定する
+    return GatewayClock::nowMs();
+}
+
+void GatewayFIB::putEntry(std::string_view name, const FIBEntry& entry) {
+    bool is_new = !cache_.contains(name);
+
+    cache_.put(name, entry, [this](std::string_view evicted) {
+        filter_.remove(filterHash(evicted));
+    });
+
+    if (is_new) {
+        filter_.add(filterHash(name));
+    }
+}
+
+void GatewayFIB::save(std::string_view content_name, const std::set<std::string>& mac_addresses) {
+    std::string normalized;
+    if (!isCanonical(content_name)) {
+        normalized = canonicalize(content_name);
+        content_name = normalized;
+    }
 
-void GatewayFIB::save(const std::string& content_name, const std::set<std::string>& mac_addresses) {
     FIBEntry entry;
     entry.isVirtual = false;
     entry.maximumDepth = calculateDepth(content_name);
-    entry.macAddresses = mac_addresses;
 
-    cache_.put(content_name, entry);
+    uint64_t now_ms = nowMs();
+    for (const auto& text : mac_addresses) {
+        MacAddress mac;
+        if (entry.nextHopCount < kMaxNextHops && MacAddress::parse(text, mac)) {
+            entry.nextHops[entry.nextHopCount++] = NextHop{mac, now_ms};
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    putEntry(content_name, entry);
 }
 
-std::set<std::string> GatewayFIB::lookup(const std::string& content_name) {
-    int nameDepth = calculateDepth(content_name);
+std::string_view GatewayFIB::routeName(std::string_view content_name, std::string& normalized) const {
+    if (!isCanonical(content_name)) {
+        normalized = canonicalize(content_name);
+        content_name = normalized;
+    }
+
+    // 集約: 指定深さのプレフィックスを経路として登録する
+    if (aggregateDepth_ > 0) {
+        content_name = extractPrefix(content_name, aggregateDepth_);
+    }
+    return content_name;
+}
+
+GatewayFIB::LearnResult GatewayFIB::learn(std::string_view content_name, const MacAddress& mac,
+                                          std::string* learned_name) {
+    std::string normalized;
+    content_name = routeName(content_name, normalized);
+    if (learned_name) {
+        learned_name->assign(content_name);
+    }
+
+    uint64_t now_ms = nowMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    return learnLocked(content_name, mac, now_ms);
+}
+
+GatewayFIB::LearnResult GatewayFIB::replace(std::string_view content_name, const MacAddress& worse_mac,
+                                            const MacAddress& mac, std::string* learned_name) {
+    std::string normalized;
+    content_name = routeName(content_name, normalized);
+    if (learned_name) {
+        learned_name->assign(content_name);
+    }
+
+    uint64_t now_ms = nowMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 遠い経路を外してから学習する（同じロック内なので検索が空のエントリを見ることはない）
+    FIBEntry* entry = worse_mac == mac ? nullptr : cache_.find(content_name);
+    if (entry && !entry->isVirtual) {
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < entry->nextHopCount; i++) {
+            if (!(entry->nextHops[i].mac == worse_mac)) {
+                entry->nextHops[kept++] = entry->nextHops[i];
+            }
+        }
+        entry->nextHopCount = kept;
+    }
+    return learnLocked(content_name, mac, now_ms);
+}
+
+GatewayFIB::LearnResult GatewayFIB::learnLocked(std::string_view content_name, const MacAddress& mac,
+                                                uint64_t now_ms) {
+    // まずLRU順序を変えずに確認し、直近に学習済みなら何もしない
+    const FIBEntry* current = cache_.peek(content_name);
+    if (current && !current->isVirtual) {
+        for (uint8_t i = 0; i < current->nextHopCount; i++) {
+            const NextHop& hop = current->nextHops[i];
+            if (hop.mac == mac && now_ms - hop.lastSeenMs < kRefreshIntervalMs) {
+                learnStats_.skipped++;
+                return LearnResult::Skipped;
+            }
+        }
+
+        // 既存エントリをその場で更新（LRUの先頭へ移動）
+        FIBEntry* entry = cache_.find(content_name);
+        for (uint8_t i = 0; i < entry->nextHopCount; i++) {
+            if (entry->nextHops[i].mac == mac) {
+                entry->nextHops[i].lastSeenMs = now_ms;
+                learnStats_.refreshed++;
+                return LearnResult::Refreshed;
+            }
+        }
+
+        // 別経路のMAC: 空きがなければ最も古いものを置き換える
+        uint8_t slot = entry->nextHopCount;
+        if (slot == kMaxNextHops) {
+            slot = 0;
+            for (uint8_t i = 1; i < entry->nextHopCount; i++) {
+                if (entry->nextHops[i].lastSeenMs < entry->nextHops[slot].lastSeenMs) {
+                    slot = i;
+                }
+            }
+        } else {
+            entry->nextHopCount++;
+        }
+        entry->nextHops[slot] = NextHop{mac, now_ms};
+        learnStats_.merged++;
+        return LearnResult::Merged;
+    }
+
     FIBEntry entry;
+    entry.isVirtual = false;
+    entry.maximumDepth = calculateDepth(content_name);
+    entry.nextHops[0] = NextHop{mac, now_ms};
+    entry.nextHopCount = 1;
+    putEntry(content_name, entry);
+    learnStats_.created++;
+    return LearnResult::Created;
+}
+
+std::set<std::string> GatewayFIB::nextHopSet(const FIBEntry& entry) {
+    uint64_t freshest = 0;
+    for (uint8_t i = 0; i < entry.nextHopCount; i++) {
+        freshest = std::max(freshest, entry.nextHops[i].lastSeenMs);
+    }
+
+    // 長く使われていない経路は、より新しい経路がある限り使わない
+    std::set<std::string> macs;
+    for (uint8_t i = 0; i < entry.nextHopCount; i++) {
+        if (freshest - entry.nextHops[i].lastSeenMs <= kRouteLifetimeMs) {
+            macs.insert(entry.nextHops[i].mac.toString());
+        }
+    }
+    return macs;
+}
+
+std::set<std::string> GatewayFIB::lookup(std::string_view content_name, bool* rejected_by_filter) {
+    if (rejected_by_filter) {
+        *rejected_by_filter = false;
+    }
+
+    // 正規形（'/'始まり、空コンポーネントなし）でなければ一度だけ正規化する
+    std::string normalized;
+    if (!isCanonical(content_name)) {
+        normalized = canonicalize(content_name);
+        content_name = normalized;
+    }
 
-    if (fibLpmLookup(content_name, nameDepth, maxVirtualDepth_, entry)) {
-        return entry.macAddresses;
+    int nameDepth = calculateDepth(content_name);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 否定キャッシュ: どの深さのプレフィックスもFIBになければLPMを省略
+    if (filterEnabled_ && !mayHaveRoute(content_name, nameDepth)) {
+        filterStats_.rejected++;
+        if (rejected_by_filter) {
+            *rejected_by_filter = true;
+        }
+        return std::set<std::string>();
+    }
+    if (filterEnabled_) {
+        filterStats_.passed++;
+    }
+
+    if (const FIBEntry* entry = fibLpmLookup(content_name, nameDepth, maxVirtualDepth_)) {
+        return nextHopSet(*entry);
     }
 
+    if (filterEnabled_) {
+        filterStats_.falsePositives++;
+    }
     return std::set<std::string>();
 }
 
-void GatewayFIB::remove(const std::string& content_name) {
-    cache_.remove(content_name);
+void GatewayFIB::remove(std::string_view content_name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cache_.remove(content_name)) {
+        filter_.remove(filterHash(content_name));
+    }
 }
 
-bool GatewayFIB::find(const std::string& content_name) {
+bool GatewayFIB::find(std::string_view content_name) {
+    std::lock_guard<std::mutex> lock(mutex_);
     return cache_.contains(content_name);
 }
 
-std::string GatewayFIB::extractPrefix(const std::string& name, int prefixDepth) const {
-    if (prefixDepth <= 0) {
-        return "";
+void GatewayFIB::dump(std::ostream& os, std::string_view prefix) const {
+    uint64_t now_ms = nowMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    os << "entries=" << cache_.size() << "/" << kCapacity << "\n";
+    cache_.forEach([&](std::string_view name, const FIBEntry& entry) {
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            return;
+        }
+        os << name;
+        if (entry.isVirtual) {
+            os << " (virtual, depth<=" << entry.maximumDepth << ")";
+        }
+        char mac[MacAddress::kStringSize];
+        for (uint8_t i = 0; i < entry.nextHopCount; i++) {
+            entry.nextHops[i].mac.format(mac);
+            os << " " << mac << " age=" << (now_ms - entry.nextHops[i].lastSeenMs) / 1000 << "s";
+        }
+        os << "\n";
+    });
+}
+
+size_t GatewayFIB::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_.size();
+}
+
+GatewayFIB::FilterStats GatewayFIB::filterStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return filterStats_;
+}
+
+GatewayFIB::LearnStats GatewayFIB::learnStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return learnStats_;
+}
+
+void GatewayFIB::setFilterEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filterEnabled_ = enabled;
+}
+
+bool GatewayFIB::mayHaveRoute(std::string_view name, int nameDepth) const {
+    if (nameDepth > kMaxFilterDepth) {
+        return true;
     }
 
-    std::vector<std::string> components;
-    std::stringstream ss(name);
-    std::string component;
+    // 名前を1回走査して全深さのプレフィックスのハッシュを得る
+    uint64_t hashes[kMaxFilterDepth];
+    int count = prefixHashes(name, hashes, kMaxFilterDepth);
 
-    while (std::getline(ss, component, '/')) {
-        if (!component.empty()) {
-            components.push_back(component);
+    for (int i = count - 1; i >= 0; i--) {
+        if (filter_.mightContain(hashes[i])) {
+            return true;
         }
     }
+    return false;
+}
 
-    if (prefixDepth > components.size()) {
-        prefixDepth = components.size();
+// フィルタ用ハッシュ: FNV-1a（プレフィックスごとに途中結果を取り出せる）
+static uint64_t fnvStep(uint64_t h, char c) {
+    return (h ^ static_cast<uint8_t>(c)) * 0x100000001B3ULL;
+}
+
+static constexpr uint64_t kFnvOffset = 0xCBF29CE484222325ULL;
+
+uint64_t GatewayFIB::filterHash(std::string_view name) {
+    uint64_t h = kFnvOffset;
+    for (char c : name) {
+        h = fnvStep(h, c);
+    }
+    return CacheKeyHasher::mix(h);
+}
+
+int GatewayFIB::prefixHashes(std::string_view name, uint64_t* out, int maxDepth) {
+    // 正規形の名前で、'/'の直前と末尾がそれぞれ深さ1..nのプレフィックスの終端
+    uint64_t h = kFnvOffset;
+    int count = 0;
+
+    for (size_t i = 0; i < name.size() && count < maxDepth; i++) {
+        if (name[i] == '/' && i > 0) {
+            out[count++] = CacheKeyHasher::mix(h);
+        }
+        h = fnvStep(h, name[i]);
+    }
+    if (count < maxDepth && !name.empty()) {
+        out[count++] = CacheKeyHasher::mix(h);
+    }
+    return count;
+}
+
+bool GatewayFIB::isCanonical(std::string_view name) {
+    if (name.size() < 2 || name[0] != '/' || name.back() == '/') {
+        return false;
     }
+    return name.find("//") == std::string_view::npos;
+}
+
+std::string GatewayFIB::canonicalize(std::string_view name) {
+    std::string out;
+    size_t pos = 0;
+
+    while (pos < name.size()) {
+        size_t end = name.find('/', pos);
+        if (end == std::string_view::npos) {
+            end = name.size();
+        }
+        if (end > pos) {
+            out += '/';
+            out.append(name.data() + pos, end - pos);
+        }
+        pos = end + 1;
+    }
+    return out;
+}
 
-    std::ostringstream oss;
+std::string_view GatewayFIB::extractPrefix(std::string_view name, int prefixDepth) const {
+    // nameは正規形であること（先頭からprefixDepth個のコンポーネントを切り出す）
+    if (prefixDepth <= 0) {
+        return std::string_view();
+    }
+
+    size_t pos = 0;
     for (int i = 0; i < prefixDepth; i++) {
-        oss << "/" << components[i];
+        pos = name.find('/', pos + 1);
+        if (pos == std::string_view::npos) {
+            return name;
+        }
     }
 
-    return oss.str();
+    return name.substr(0, pos);
 }
 
-bool GatewayFIB::lookupEntry(const std::string& name, int prefixDepth, FIBEntry& outEntry) {
-    std::string prefix = extractPrefix(name, prefixDepth);
-    return cache_.get(prefix, outEntry);
+const GatewayFIB::FIBEntry* GatewayFIB::lookupEntry(std::string_view name, int prefixDepth) {
+    return cache_.find(extractPrefix(name, prefixDepth));
 }
 
-bool GatewayFIB::fibLpmLookup(const std::string& name, int nameDepth, int maxVirtualDepth, FIBEntry& outEntry) {
+const GatewayFIB::FIBEntry* GatewayFIB::fibLpmLookup(std::string_view name, int nameDepth, int maxVirtualDepth) {
     // ステージ1: 完全一致
-    if (lookupEntry(name, nameDepth, outEntry)) {
-        return true;
+    if (const FIBEntry* entry = lookupEntry(name, nameDepth)) {
+        return entry;
     }
 
     // ステージ2: 最長プレフィックス一致
     for (int depth = nameDepth - 1; depth > 0; depth--) {
-        FIBEntry entry;
-        if (lookupEntry(name, depth, entry)) {
-            if (!entry.isVirtual) {
-                outEntry = entry;
-                return true;
+        if (const FIBEntry* entry = lookupEntry(name, depth)) {
+            if (!entry->isVirtual) {
+                return entry;
             }
 
             // 仮想エントリ: 最大深度をチェック
-            if (nameDepth <= entry.maximumDepth + maxVirtualDepth) {
-                outEntry = entry;
-                return true;
+            if (nameDepth <= entry->maximumDepth + maxVirtualDepth) {
+                return entry;
             }
         }
     }
 
-    return false;
+    return nullptr;
 }
 
-int GatewayFIB::calculateDepth(const std::string& name) const {
+int GatewayFIB::calculateDepth(std::string_view name) const {
     if (name.empty() || name == "/") {
         return 0;
     }
 
+    // コンポーネント数（正規形では'/'の数と等しい）
     int depth = 0;
     for (char c : name) {
         if (c == '/') {
@@ -102,10 +385,10 @@ int GatewayFIB::calculateDepth(const std::string& name) const {
         }
     }
 
-    // 名前が'/'で始まる場合は調整
-    if (name[0] == '/') {
-        depth--;
+    // 名前が'/'で始まらない場合は先頭コンポーネントの分を加える
+    if (name[0] != '/') {
+        depth++;
     }
 
-    return depth > 0 ? depth : 1;
+    return depth;
 }
@@ -1,52 +1,349 @@
 #include <iostream>
-#include <csignal>
 #include <memory>
+#include <sstream>
+#include <string>
 #include "main_controller.h"
 
-std::unique_ptr<MainController> g_controller;
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [uart_device] [baudrate] [options]\n"
+              << "Options:\n"
+              << "  --rtscts                   Enable RTS/CTS hardware flow control on the UART\n"
+              << "  --serial-test[=SEC]        Loopback link test (TX wired to RX) for SEC seconds (default 10), then exit\n"
+              << "  --event-loop               Run everything on a single epoll thread\n"
+              << "  --publishers=N             Publish through N dedicated cefnetd connections (threaded mode)\n"
+              << "  --fib-aggregate=DEPTH      Learn routes for the DEPTH-component prefix of each name\n"
+              << "  --dedup[=MS]               Suppress mesh duplicates of the same DATA within MS (default 2000)\n"
+              << "  --replicate[=PORT]         Share learned FIB routes with other gateways over UDP (default port 5790)\n"
+              << "  --replicate-group=ADDR     Multicast group for replication (default 239.255.77.1)\n"
+              << "  --replicate-peer=IP:PORT   Send to this peer by unicast instead of multicast (repeatable)\n"
+              << "  --replicate-sync=MS        Anti-entropy digest period (default 2000)\n"
+              << "  --history                  Keep recent readings per name and answer timestamp/range Interests\n"
+              << "  --history-file=PATH        Persist the history ring in an mmap'ed file\n"
+              << "  --segment[=SIZE]           Split objects larger than SIZE bytes into chunks (default 1024)\n"
+              << "  --segment-window=N         Chunks pre-published on sequential access (default 8)\n"
+              << "  --backlog=N                Keep up to N unsent Content Objects while cefnetd is down (default 64, 0: off)\n"
+              << "  --backlog-file=PATH        Spill backlog overflow to PATH\n"
+              << "  --backlog-drain=N          Replay at most N backlog entries per 100ms tick (default 20)\n"
+              << "  --control[=PATH]           Open a control socket (default /tmp/gateway-<pid>.sock)\n"
+              << "  --log-level=LEVEL          error, info (default) or debug\n"
+              << "  --cache-time=S             Cache time of published Content Objects (default 300)\n"
+              << "  --expiry=S                 Expiry of published Content Objects (default 3600)\n"
+              << "  --capture=FILE             Record every raw UART RX/TX line with timestamps\n"
+              << "  --replay=FILE              Feed a capture through the gateway instead of the UART, then exit\n"
+              << "  --replay-speed=N|fast      Replay at N times the captured timing (default 1) or as fast as possible\n"
+              << "  --trace                    Record per-packet trace spans (dump with SIGUSR1)\n"
+              << "  --trace-file=PATH          Trace dump path (default /tmp/gateway-trace-<pid>.json)\n"
+              << "  --prefetch                 Proactively poll sensors for popular names\n"
+              << "  --prefetch-interval=MS     Prefetch period (default 5000)\n"
+              << "  --prefetch-budget=N        Max prefetch Interests per period (default 4)\n"
+              << "  --rate-limit               Enable token-bucket admission control for Interests\n"
+              << "  --mac-rate=N[,BURST]       Interests/s per destination MAC (default 5,10)\n"
+              << "  --prefix-rate=N[,BURST]    Interests/s per name prefix (default 20,40)\n"
+              << "  --serial-share=PCT         Share of serial bandwidth for TX (default 50)\n"
+              << "  --realtime                 Enable realtime mode (CPU pinning, SCHED_FIFO, mlockall)\n"
+              << "  --rt-cpus=RX,TX,CEFORE     CPU for UART RX / UART TX / CEFORE RX threads (-1: no pinning)\n"
+              << "  --rt-priority=P|RX,TX,CEFORE  SCHED_FIFO priority (0: SCHED_OTHER)\n"
+              << "  --no-mlock                 Do not lock memory in realtime mode\n";
+}
+
+static bool parseNumber(const std::string& value, uint32_t& out) {
+    try {
+        size_t used = 0;
+        unsigned long parsed = std::stoul(value, &used);
+        if (used != value.size() || parsed > UINT32_MAX) {
+            return false;
+        }
+        out = static_cast<uint32_t>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
 
-void signalHandler(int signum) {
-    std::cout << "\nInterrupt signal (" << signum << ") received." << std::endl;
+// "a,b,c" 形式をスレッドごとの値に展開（1つだけなら全スレッドに適用）
+static bool parseThreadList(const std::string& value, int (&out)[RealtimeConfig::kThreadCount]) {
+    std::stringstream ss(value);
+    std::string item;
+    size_t count = 0;
 
-    if (g_controller) {
-        g_controller->shutdown();
+    try {
+        while (std::getline(ss, item, ',')) {
+            if (count >= RealtimeConfig::kThreadCount) {
+                return false;
+            }
+            out[count++] = std::stoi(item);
+        }
+    } catch (const std::exception&) {
+        return false;
     }
 
-    exit(signum);
+    if (count == 1) {
+        for (size_t i = 1; i < RealtimeConfig::kThreadCount; i++) {
+            out[i] = out[0];
+        }
+        return true;
+    }
+    return count == RealtimeConfig::kThreadCount;
 }
 
-int main(int argc, char* argv[]) {
-    // Parse command line arguments
-    std::string uart_device = "/dev/serial0";
-    int baudrate = 115200;
+// "rate[,burst]" 形式（バースト省略時はレートの2倍）
+static bool parseRate(const std::string& value, uint32_t& rate, uint32_t& burst) {
+    size_t comma = value.find(',');
+    if (!parseNumber(value.substr(0, comma), rate) || rate == 0) {
+        return false;
+    }
+    if (comma == std::string::npos) {
+        burst = rate * 2;
+        return true;
+    }
+    return parseNumber(value.substr(comma + 1), burst) && burst > 0;
+}
+
+static bool parseArguments(int argc, char* argv[], GatewayConfig& config) {
+    int positional = 0;
 
-    if (argc >= 2) {
-        uart_device = argv[1];
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "--") != 0) {
+            // 位置引数: UARTデバイス、ボーレート
+            try {
+                if (positional == 0) {
+                    config.uart_device = arg;
+                } else if (positional == 1) {
+                    config.baudrate = std::stoi(arg);
+                    if (config.baudrate <= 0) {
+                        return false;
+                    }
+                } else {
+                    return false;
+                }
+            } catch (const std::exception&) {
+                return false;
+            }
+            positional++;
+            continue;
+        }
+
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+
+        if (key == "--event-loop") {
+            config.event_loop = true;
+        } else if (key == "--rtscts") {
+            config.rtscts = true;
+        } else if (key == "--serial-test") {
+            config.serial_test_sec = 10;
+            if (!value.empty() && (!parseNumber(value, config.serial_test_sec) ||
+                                   config.serial_test_sec == 0)) {
+                return false;
+            }
+        } else if (key == "--publishers") {
+            uint32_t count = 0;
+            if (!parseNumber(value, count) || count > 16) {
+                return false;
+            }
+            config.publishers = count;
+        } else if (key == "--fib-aggregate") {
+            uint32_t depth = 0;
+            if (!parseNumber(value, depth) || depth == 0 || depth > 16) {
+                return false;
+            }
+            config.fib_aggregate_depth = static_cast<int>(depth);
+        } else if (key == "--dedup") {
+            config.dedup_window_ms = 2000;
+            if (!value.empty() && (!parseNumber(value, config.dedup_window_ms) ||
+                                   config.dedup_window_ms == 0)) {
+                return false;
+            }
+        } else if (key == "--replicate") {
+            config.replication.enabled = true;
+            if (!value.empty()) {
+                uint32_t port = 0;
+                if (!parseNumber(value, port) || port == 0 || port > 65535) {
+                    return false;
+                }
+                config.replication.port = static_cast<uint16_t>(port);
+            }
+        } else if (key == "--replicate-group") {
+            if (value.empty()) {
+                return false;
+            }
+            config.replication.enabled = true;
+            config.replication.group = value;
+        } else if (key == "--replicate-peer") {
+            if (value.empty()) {
+                return false;
+            }
+            config.replication.enabled = true;
+            config.replication.peers.push_back(value);
+        } else if (key == "--replicate-sync") {
+            if (!parseNumber(value, config.replication.sync_interval_ms) ||
+                config.replication.sync_interval_ms == 0) {
+                return false;
+            }
+        } else if (key == "--history") {
+            config.history.enabled = true;
+        } else if (key == "--history-file") {
+            if (value.empty()) {
+                return false;
+            }
+            config.history.enabled = true;
+            config.history.path = value;
+        } else if (key == "--segment") {
+            config.segment.enabled = true;
+            if (!value.empty()) {
+                uint32_t size = 0;
+                if (!parseNumber(value, size) || size < 64 || size > CeforeInterface::kMaxQueuedPayload) {
+                    return false;
+                }
+                config.segment.segment_size = size;
+            }
+        } else if (key == "--segment-window") {
+            // 先読み分は要求分と同じ公開キューに積まれるため、キューに収まる数まで
+            if (!parseNumber(value, config.segment.window) ||
+                config.segment.window >= CeforeInterface::kPublishQueueSize) {
+                return false;
+            }
+            config.segment.enabled = true;
+        } else if (key == "--backlog") {
+            uint32_t capacity = 0;
+            if (!parseNumber(value, capacity)) {
+                return false;
+            }
+            config.backlog.capacity = capacity;
+        } else if (key == "--backlog-file") {
+            if (value.empty()) {
+                return false;
+            }
+            config.backlog.path = value;
+        } else if (key == "--backlog-drain") {
+            if (!parseNumber(value, config.backlog.drain_per_tick) || config.backlog.drain_per_tick == 0) {
+                return false;
+            }
+        } else if (key == "--control") {
+            config.control = true;
+            config.control_path = value;
+        } else if (key == "--log-level") {
+            if (!GatewayLog::parse(value, config.log_level)) {
+                return false;
+            }
+        } else if (key == "--cache-time") {
+            if (!parseNumber(value, config.cache_time_sec)) {
+                return false;
+            }
+        } else if (key == "--expiry") {
+            if (!parseNumber(value, config.expiry_sec) || config.expiry_sec == 0) {
+                return false;
+            }
+        } else if (key == "--capture") {
+            if (value.empty()) {
+                return false;
+            }
+            config.capture_path = value;
+        } else if (key == "--replay") {
+            if (value.empty()) {
+                return false;
+            }
+            config.replay.path = value;
+        } else if (key == "--replay-speed") {
+            if (value == "fast") {
+                config.replay.speed = 0;
+            } else if (!parseNumber(value, config.replay.speed) || config.replay.speed == 0) {
+                return false;
+            }
+        } else if (key == "--trace") {
+            config.trace = true;
+        } else if (key == "--trace-file") {
+            if (value.empty()) {
+                return false;
+            }
+            config.trace = true;
+            config.trace_path = value;
+        } else if (key == "--prefetch") {
+            config.prefetch.enabled = true;
+        } else if (key == "--prefetch-interval") {
+            if (!parseNumber(value, config.prefetch.interval_ms) || config.prefetch.interval_ms == 0) {
+                return false;
+            }
+        } else if (key == "--prefetch-budget") {
+            if (!parseNumber(value, config.prefetch.budget)) {
+                return false;
+            }
+        } else if (key == "--rate-limit") {
+            config.admission.enabled = true;
+        } else if (key == "--mac-rate") {
+            if (!parseRate(value, config.admission.mac_rate, config.admission.mac_burst)) {
+                return false;
+            }
+            config.admission.enabled = true;
+        } else if (key == "--prefix-rate") {
+            if (!parseRate(value, config.admission.prefix_rate, config.admission.prefix_burst)) {
+                return false;
+            }
+            config.admission.enabled = true;
+        } else if (key == "--serial-share") {
+            if (!parseNumber(value, config.admission.serial_share) ||
+                config.admission.serial_share == 0 || config.admission.serial_share > 100) {
+                return false;
+            }
+            config.admission.enabled = true;
+        } else if (key == "--realtime") {
+            config.realtime.enabled = true;
+        } else if (key == "--rt-cpus") {
+            if (!parseThreadList(value, config.realtime.cpu)) {
+                return false;
+            }
+        } else if (key == "--rt-priority") {
+            if (!parseThreadList(value, config.realtime.priority)) {
+                return false;
+            }
+        } else if (key == "--no-mlock") {
+            config.realtime.lock_memory = false;
+        } else {
+            return false;
+        }
     }
 
-    if (argc >= 3) {
-        baudrate = std::stoi(argv[2]);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    GatewayConfig config;
+
+    if (!parseArguments(argc, argv, config)) {
+        printUsage(argv[0]);
+        return 1;
     }
 
     std::cout << "=== Raspberry Pi CEFORE Gateway ===" << std::endl;
-    std::cout << "UART Device: " << uart_device << std::endl;
-    std::cout << "Baudrate: " << baudrate << std::endl;
+    std::cout << "UART Device: " << config.uart_device << std::endl;
+    std::cout << "Baudrate: " << config.baudrate << std::endl;
     std::cout << "===================================" << std::endl;
 
-    // Register signal handler
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // リンク試験はcefnetdなしでUARTだけを使う
+    if (config.serial_test_sec > 0) {
+        UARTReceiver uart(config.uart_device, config.baudrate);
+        uart.setFlowControl(config.rtscts);
+        return uart.runSelfTest(config.serial_test_sec * 1000, std::cout) ? 0 : 1;
+    }
+
+    // Block SIGINT/SIGTERM/SIGUSR1 before any thread starts; the controller waits for them
+    MainController::blockSignals();
 
     // Create and initialize controller
-    g_controller = std::make_unique<MainController>();
+    auto controller = std::make_unique<MainController>();
 
-    if (!g_controller->initialize(uart_device, baudrate)) {
+    if (!controller->initialize(config)) {
         std::cerr << "Initialization failed" << std::endl;
         return 1;
     }
 
-    // Run main loop
-    g_controller->run();
+    // Run main loop until a shutdown signal arrives
+    controller->run();
+    controller->shutdown();
 
     return 0;
 }
@@ -1,17 +1,24 @@
 #include "main_controller.h"
-#include "third_party/base64.h"
+#include "packet_tracer.h"
+#include "gateway_log.h"
+#include "gateway_clock.h"
 #include <iostream>
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
 
-// ESP-NOWプロトコル用のCommunicationData構造体
-struct __attribute__((packed)) CommunicationData {
-    char signalCode[10];
-    uint8_t hopCount;
-    char contentName[100];
-    char content[20];
-};
+// 制御用シグナル（シグナルハンドラではなくsigtimedwait/signalfdで同期的に受ける）
+static sigset_t controlSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);   // トレースのダンプ
+    return signals;
+}
 
 MainController::MainController() {}
 
@@ -19,13 +26,63 @@ MainController::~MainController() {
     shutdown();
 }
 
-bool MainController::initialize(const std::string& uart_device, int baudrate) {
+bool MainController::initialize(const GatewayConfig& config) {
+    config_ = config;
+    cache_time_sec_ = config.cache_time_sec;
+    expiry_sec_ = config.expiry_sec;
+    GatewayLog::setLevel(config.log_level);
+
     // コンポーネント作成
-    uart_ = std::make_unique<UARTReceiver>(uart_device, baudrate);
+    uart_ = std::make_unique<UARTReceiver>(config.uart_device, config.baudrate);
+    uart_->setFlowControl(config.rtscts);
     parser_ = std::make_unique<PacketParser>();
     cefore_ = std::make_unique<CeforeInterface>();
     name_mapper_ = std::make_unique<NameMapper>();
-    fib_ = std::make_unique<GatewayFIB>();
+    fib_ = std::make_unique<GatewayFIB>(3, config.fib_aggregate_depth);
+    reassembler_ = std::make_unique<FragmentReassembler>();
+    if (config.prefetch.enabled) {
+        popularity_ = std::make_unique<PopularityTracker>(config.prefetch.top_k);
+    }
+    if (config.admission.enabled) {
+        admission_ = std::make_unique<AdmissionController>(config.admission, config.baudrate);
+    }
+    if (config.dedup_window_ms > 0) {
+        dedup_ = std::make_unique<DuplicateFilter>(config.dedup_window_ms);
+    }
+    if (config.replication.enabled) {
+        replicator_ = std::make_unique<FibReplicator>(*fib_, config.replication);
+        if (!replicator_->open()) {
+            std::cerr << "FIB replication initialization failed" << std::endl;
+            return false;
+        }
+    }
+    if (config.history.enabled) {
+        history_ = std::make_unique<SensorHistory>();
+        if (!history_->open(config.history.path)) {
+            std::cerr << "Sensor history initialization failed" << std::endl;
+            return false;
+        }
+        // 分割公開するなら範囲問い合わせの全件を1つの応答に組み立てられる大きさにする
+        constexpr size_t kMaxRangeAnswer =
+            SensorHistory::kSamplesPerSeries * (SensorHistory::kRecordHeaderSize + SensorHistory::kValueStride);
+        history_buff_.resize(config.segment.enabled ? kMaxRangeAnswer : CeforeInterface::kMaxQueuedPayload);
+    }
+
+    if (config.segment.enabled) {
+        segments_ = std::make_unique<SegmentStore>(config.segment);
+        segment_buff_.resize(config.segment.segment_size);
+    }
+
+    // RX経路のバッファを事前確保
+    reassembled_name_.reserve(sizeof(CommunicationData::contentName));
+    reassembled_payload_.reserve(FragmentReassembler::kMaxMessageSize);
+    publish_uri_.reserve(sizeof(CommunicationData::contentName) + 24);
+    learned_name_.reserve(sizeof(CommunicationData::contentName) + 1);
+
+    // cefnetd切断中に公開できなかったものを保持し、再接続後に再公開する
+    if (config.backlog.capacity > 0) {
+        cefore_->enableBacklog(config.backlog);
+    }
 
     // CEFORE初期化
     if (!cefore_->init()) {
@@ -38,6 +95,15 @@ bool MainController::initialize(const std::string& uart_device, int baudrate) {
         return false;
     }
 
+    if (!config.capture_path.empty()) {
+        capture_ = std::make_unique<TrafficCapture>();
+        if (!capture_->open(config.capture_path)) {
+            std::cerr << "UART capture initialization failed" << std::endl;
+            return false;
+        }
+        uart_->setCapture(capture_.get());
+    }
+
     // コールバック設定
     uart_->setRxCallback([this](const RxPacket& packet) {
         onRxPacket(packet);
@@ -47,100 +113,941 @@ bool MainController::initialize(const std::string& uart_device, int baudrate) {
         onInterest(uri, chunk_num);
     });
 
-    // UART受信開始
-    uart_->start();
+    // リアルタイムモード: スレッド開始前にメモリをロックし、以降のページフォルトを防ぐ
+    if (config.realtime.enabled) {
+        uart_->setRealtimeConfig(config.realtime);
+        cefore_->setRealtimeConfig(config.realtime);
 
-    // CEFORE Interest受信開始
-    cefore_->startReceiving();
+        if (config.realtime.lock_memory) {
+            Realtime::lockMemory();
+            Realtime::prefaultStack(config.realtime.prefault_stack_bytes);
+        }
+        std::cout << "Realtime mode enabled" << std::endl;
+    }
+
+    bool replaying = !config.replay.path.empty();
+
+    if (config.event_loop && !replaying) {
+        // イベントループモード: ポートを開くだけで受信スレッドは作らない
+        if (!uart_->openPort(true)) {
+            std::cerr << "UART open failed" << std::endl;
+            return false;
+        }
+    } else {
+        // 公開専用の接続とスレッド（イベントループモードでは単一スレッドのまま同期的に公開する）
+        if (config.publishers > 0 && !cefore_->startPublishers(config.publishers)) {
+            std::cerr << "CEFORE publisher startup failed" << std::endl;
+            return false;
+        }
+
+        if (replaying) {
+            // リプレイ: ポートを開かず、受信行はrunReplay()がメインスレッドから流し込む
+            uart_->detach();
+        } else {
+            // UART受信開始
+            uart_->start();
+        }
+
+        // CEFORE Interest受信開始
+        cefore_->startReceiving();
+
+        if (replicator_) {
+            replicator_->start();
+        }
+    }
+
+    if (config.trace) {
+        PacketTracer::setEnabled(true);
+        std::cout << "Packet tracing enabled (send SIGUSR1 to dump)" << std::endl;
+    }
+
+    if (config.control) {
+        std::string path = config.control_path;
+        if (path.empty()) {
+            path = "/tmp/gateway-" + std::to_string(getpid()) + ".sock";
+        }
+        control_ = std::make_unique<ControlServer>(path);
+        if (!control_->open()) {
+            std::cerr << "Control socket initialization failed" << std::endl;
+            return false;
+        }
+        registerControlCommands();
+    }
 
     std::cout << "Gateway initialized successfully" << std::endl;
     return true;
 }
 
+void MainController::blockSignals() {
+    sigset_t signals = controlSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
 void MainController::run() {
     std::cout << "Gateway running... Press Ctrl+C to stop" << std::endl;
 
-    // メインループ
+    last_report_ms_ = GatewayClock::nowMs();
+    last_prefetch_ms_ = last_report_ms_;
+
+    if (!config_.replay.path.empty()) {
+        runReplay();
+    } else if (config_.event_loop) {
+        runEventLoop();
+    } else {
+        runThreaded();
+    }
+}
+
+void MainController::runThreaded() {
+    // メインスレッドはシグナル待ちと周期処理のみ
+    sigset_t signals = controlSignals();
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = kTickIntervalMs * 1000000L;
+
     while (true) {
-        sleep(1);
+        int signum = sigtimedwait(&signals, nullptr, &timeout);
+        if (signum == SIGUSR1) {
+            dumpTrace();
+            continue;
+        }
+        if (signum > 0) {
+            std::cout << "\nInterrupt signal (" << signum << ") received." << std::endl;
+            return;
+        }
+        onTick();
+    }
+}
+
+void MainController::runEventLoop() {
+    // UART・cefnetdソケット・timerfd・signalfdを1つのepollで多重化する
+    EventLoop loop;
+    if (!loop.init()) {
+        return;
+    }
+
+    if (config_.realtime.enabled) {
+        Realtime::applyToCurrentThread(config_.realtime, GatewayThread::UartRx);
+    }
+
+    loop.addFd(uart_->fd(), [this]() { uart_->handleReadable(); });
+
+    event_loop_ = &loop;
+    watchCeforeSocket();
+
+    if (replicator_) {
+        loop.addFd(replicator_->fd(), [this]() { replicator_->handleReadable(); });
+    }
+
+    loop.addTimer(kTickIntervalMs, [this]() { onTick(); });
+
+    loop.addSignals(controlSignals(), [this, &loop](int signum) {
+        if (signum == SIGUSR1) {
+            dumpTrace();
+            return;
+        }
+        std::cout << "\nInterrupt signal (" << signum << ") received." << std::endl;
+        loop.stop();
+    });
+
+    std::cout << "Running single-threaded event loop" << std::endl;
+    loop.run();
+    event_loop_ = nullptr;
+}
+
+void MainController::watchCeforeSocket() {
+    int fd = cefore_->socketFd();
+    if (fd >= 0 && event_loop_->addFd(fd, [this]() { cefore_->handleReadable(); })) {
+        cefore_fd_ = fd;
+        cefore_polling_ = false;
+        return;
+    }
+
+    // ソケットを特定できない場合のみ1ms周期でポーリング
+    std::cerr << "cefnetd socket not found, polling every 1ms" << std::endl;
+    cefore_polling_ = true;
+    if (!cefore_poll_timer_) {
+        cefore_poll_timer_ = event_loop_->addTimer(1, [this]() {
+            if (cefore_polling_) {
+                cefore_->handleReadable();
+            }
+        });
+        if (!cefore_poll_timer_) {
+            std::cerr << "Failed to start cefnetd polling timer, Interests will not be received" << std::endl;
+        }
+    }
+}
+
+void MainController::runReplay() {
+    TrafficCapture::Reader reader;
+    if (!reader.open(config_.replay.path)) {
+        return;
+    }
+
+    // 待ち時間はsigtimedwaitで過ごし、再生中もシグナルを受け付ける
+    sigset_t signals = controlSignals();
+    auto serviceUntil = [&](uint64_t due_ns) {
+        while (true) {
+            uint64_t now_ns = JitterProbe::nowNs();
+            uint64_t wait_ns = due_ns > now_ns ? due_ns - now_ns : 0;
+            wait_ns = std::min<uint64_t>(wait_ns, kTickIntervalMs * 1000000ULL);
+
+            struct timespec timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = static_cast<long>(wait_ns);
+            int signum = sigtimedwait(&signals, nullptr, &timeout);
+            if (signum == SIGUSR1) {
+                dumpTrace();
+            } else if (signum > 0) {
+                std::cout << "\nInterrupt signal (" << signum << ") received." << std::endl;
+                return false;
+            }
+            if (JitterProbe::nowNs() >= due_ns) {
+                return true;
+            }
+        }
+    };
+
+    std::cout << "Replaying " << config_.replay.path << " ("
+              << (config_.replay.speed == 0 ? std::string("as fast as possible")
+                                            : std::to_string(config_.replay.speed) + "x")
+              << ")" << std::endl;
+
+    // 時刻判定は記録時刻で行う（再生開始時の単調時計を起点にし、それ以前に記録した時刻より戻さない）
+    // 周期処理も記録時刻で100msごとに行い、再生速度に関わらず同じ位置で期限切れ判定等を走らせる
+    uint64_t base_ms = GatewayClock::monotonicMs();
+    uint64_t first_ts = 0;
+    bool have_first = false;
+    uint64_t next_tick_ns = kTickIntervalMs * 1000000ULL;
+    uint64_t start_ns = JitterProbe::nowNs();
+    uint64_t rx_lines = 0;
+    uint64_t parsed = 0;
+    uint64_t captured_tx = 0;
+    uint64_t tx_before = uart_->txDiscarded();
+    bool interrupted = false;
+    GatewayClock::setReplayMs(base_ms);
+    last_report_ms_ = base_ms;
+    last_prefetch_ms_ = base_ms;
+
+    // 記録開始からoffset_nsの時点まで待ち（fastでは待たない）、再生時刻を進める
+    auto advanceTo = [&](uint64_t offset_ns) {
+        if (config_.replay.speed > 0) {
+            if (!serviceUntil(start_ns + offset_ns / config_.replay.speed)) {
+                return false;
+            }
+        }
+        GatewayClock::setReplayMs(base_ms + offset_ns / 1000000ULL);
+        return true;
+    };
+
+    TrafficCapture::Reader::Record record;
+    while (reader.next(record)) {
+        if (!have_first) {
+            first_ts = record.timestampNs;
+            have_first = true;
+        }
+        if (record.direction == TrafficCapture::Direction::Tx) {
+            // 記録時の送信はゲートウェイ自身が再生成するので、比較用に数えるだけ
+            captured_tx++;
+            continue;
+        }
+
+        // 記録時刻は単調だが、壊れた記録で戻った場合はその時点に留める
+        uint64_t offset_ns = record.timestampNs > first_ts ? record.timestampNs - first_ts : 0;
+        while (next_tick_ns <= offset_ns) {
+            if (!advanceTo(next_tick_ns)) {
+                interrupted = true;
+                break;
+            }
+            onTick();
+            next_tick_ns += kTickIntervalMs * 1000000ULL;
+        }
+        if (interrupted || !advanceTo(offset_ns)) {
+            interrupted = true;
+            break;
+        }
+        if (config_.replay.speed == 0 && (rx_lines & 1023) == 0 && !serviceUntil(0)) {
+            interrupted = true;
+            break;
+        }
+
+        if (uart_->injectLine(record.line)) {
+            parsed++;
+        }
+        rx_lines++;
+    }
+    GatewayClock::stopReplay();
+
+    uint64_t elapsed_ns = JitterProbe::nowNs() - start_ns;
+    double elapsed_s = elapsed_ns / 1e9;
+    std::cout << "[replay] " << (interrupted ? "interrupted after " : "")
+              << rx_lines << " RX lines (" << parsed << " parsed) in "
+              << elapsed_ns / 1000000 << " ms, "
+              << static_cast<uint64_t>(elapsed_s > 0 ? rx_lines / elapsed_s : 0) << " lines/s; "
+              << "TX lines produced=" << (uart_->txDiscarded() - tx_before)
+              << " captured=" << captured_tx << std::endl;
+}
+
+void MainController::dumpTrace() {
+    std::string path = config_.trace_path;
+    if (path.empty()) {
+        path = "/tmp/gateway-trace-" + std::to_string(getpid()) + ".json";
+    }
+    PacketTracer::dump(path);
+}
+
+void MainController::onTick() {
+    uint64_t now_ms = GatewayClock::nowMs();
+
+    // cefnetdの死活監視・再接続と、切断中に溜まった公開の再送
+    if (cefore_->maintainConnection() && event_loop_) {
+        // 新しいソケットをepollに登録し直す（HUPで外れていなければ古いものを外す）
+        if (cefore_fd_ >= 0) {
+            event_loop_->removeFd(cefore_fd_);
+            cefore_fd_ = -1;
+        }
+        watchCeforeSocket();
+    }
+    cefore_->drainBacklog();
+
+    // 他のゲートウェイとFIBの版を突き合わせる（取りこぼしがあれば相手が再送する）
+    if (replicator_) {
+        replicator_->tick(now_ms);
+    }
+
+    // 制御コマンドは周期処理と同じスレッドで実行する（設定値の読み書きに追加のロックが不要）
+    if (control_) {
+        control_->poll();
+    }
+
+    // 再構築バッファはUART受信と同じスレッドでしか触れないため、
+    // スレッドモードではフラグメント到着時の期限切れ判定に任せる
+    if (config_.event_loop) {
+        reassembler_->expire();
+    }
+
+    // 流量制御で保留したInterestを再送（新しいInterestが来ない間も期限内に送る）
+    retryDeferredInterests();
+
+    // 人気Interestの先読み
+    if (popularity_ && now_ms - last_prefetch_ms_ >= config_.prefetch.interval_ms) {
+        prefetchPopular();
+        last_prefetch_ms_ = now_ms;
+    }
+
+    // リアルタイムモードでは1分ごとに起床遅延を報告
+    if (config_.realtime.enabled && now_ms - last_report_ms_ >= 60 * 1000) {
+        reportJitter(std::cout);
+        last_report_ms_ = now_ms;
+    }
+}
+
+void MainController::registerControlCommands() {
+    addTunables();
+
+    control_->addCommand("stats", "", [this](const ControlServer::Args&, std::ostream& out) {
+        reportStats(out);
+        return true;
+    });
+
+    control_->addCommand("fib", "[PREFIX]", [this](const ControlServer::Args& args, std::ostream& out) {
+        fib_->dump(out, args.size() > 1 ? args[1] : std::string_view());
+        return true;
+    });
+
+    control_->addCommand("log", "[error|info|debug]", [](const ControlServer::Args& args, std::ostream& out) {
+        if (args.size() > 1) {
+            LogLevel level;
+            if (!GatewayLog::parse(args[1], level)) {
+                out << "unknown log level: " << args[1] << "\n";
+                return false;
+            }
+            GatewayLog::setLevel(level);
+        }
+        out << "log=" << GatewayLog::toString(GatewayLog::level()) << "\n";
+        return true;
+    });
+
+    control_->addCommand("trace", "on|off|dump [PATH]", [this](const ControlServer::Args& args, std::ostream& out) {
+        if (args.size() > 1 && args[1] == "on") {
+            PacketTracer::setEnabled(true);
+        } else if (args.size() > 1 && args[1] == "off") {
+            PacketTracer::setEnabled(false);
+        } else if (args.size() > 1 && args[1] == "dump") {
+            if (args.size() > 2) {
+                config_.trace_path = std::string(args[2]);
+            }
+            dumpTrace();
+        } else if (args.size() > 1) {
+            out << "usage: trace on|off|dump [PATH]\n";
+            return false;
+        }
+        out << "trace=" << (PacketTracer::enabled() ? "on" : "off") << "\n";
+        return true;
+    });
+
+    control_->addCommand("get", "[NAME]", [this](const ControlServer::Args& args, std::ostream& out) {
+        bool found = false;
+        for (const Tunable& tunable : tunables_) {
+            if (args.size() < 2 || args[1] == tunable.name) {
+                out << tunable.name << "=" << tunable.get() << "  # " << tunable.help << "\n";
+                found = true;
+            }
+        }
+        if (!found) {
+            out << "unknown setting: " << args[1] << "\n";
+        }
+        return found;
+    });
+
+    control_->addCommand("set", "NAME VALUE", [this](const ControlServer::Args& args, std::ostream& out) {
+        if (args.size() != 3) {
+            out << "usage: set NAME VALUE\n";
+            return false;
+        }
+        uint32_t value = 0;
+        auto parsed = std::from_chars(args[2].data(), args[2].data() + args[2].size(), value);
+        if (parsed.ec != std::errc() || parsed.ptr != args[2].data() + args[2].size()) {
+            out << "invalid value: " << args[2] << "\n";
+            return false;
+        }
+        for (const Tunable& tunable : tunables_) {
+            if (args[1] == tunable.name) {
+                if (!tunable.set(value)) {
+                    out << "value out of range for " << tunable.name << ": " << value << "\n";
+                    return false;
+                }
+                out << tunable.name << "=" << tunable.get() << "\n";
+                return true;
+            }
+        }
+        out << "unknown setting: " << args[1] << "\n";
+        return false;
+    });
+}
+
+void MainController::addTunables() {
+    tunables_.push_back(Tunable{"cache_time", "cache time of published Content Objects (s)",
+        [this]() { return cache_time_sec_.load(); },
+        [this](uint32_t value) { cache_time_sec_ = value; return true; }});
+    tunables_.push_back(Tunable{"expiry", "expiry of published Content Objects (s)",
+        [this]() { return expiry_sec_.load(); },
+        [this](uint32_t value) {
+            if (value == 0) {
+                return false;
+            }
+            expiry_sec_ = value;
+            return true;
+        }});
+
+    if (popularity_) {
+        tunables_.push_back(Tunable{"prefetch_interval", "prefetch period (ms)",
+            [this]() { return config_.prefetch.interval_ms; },
+            [this](uint32_t value) {
+                if (value == 0) {
+                    return false;
+                }
+                config_.prefetch.interval_ms = value;
+                return true;
+            }});
+        tunables_.push_back(Tunable{"prefetch_budget", "prefetch Interests per period",
+            [this]() { return config_.prefetch.budget; },
+            [this](uint32_t value) { config_.prefetch.budget = value; return true; }});
+    }
+
+    if (admission_) {
+        // 流量制御のレートはAdmissionController側の設定を直接書き換える
+        auto add = [this](const char* name, const char* help, uint32_t AdmissionConfig::*field, uint32_t max) {
+            tunables_.push_back(Tunable{name, help,
+                [this, field]() { return admission_->config().*field; },
+                [this, field, max](uint32_t value) {
+                    if (value == 0 || value > max) {
+                        return false;
+                    }
+                    AdmissionConfig limits = admission_->config();
+                    limits.*field = value;
+                    admission_->setLimits(limits);
+                    return true;
+                }});
+        };
+        add("mac_rate", "Interests/s per destination MAC", &AdmissionConfig::mac_rate, UINT32_MAX);
+        add("mac_burst", "burst per destination MAC", &AdmissionConfig::mac_burst, UINT32_MAX);
+        add("prefix_rate", "Interests/s per name prefix", &AdmissionConfig::prefix_rate, UINT32_MAX);
+        add("prefix_burst", "burst per name prefix", &AdmissionConfig::prefix_burst, UINT32_MAX);
+        add("serial_share", "share of serial bandwidth for TX (%)", &AdmissionConfig::serial_share, 100);
+    }
+
+    if (segments_) {
+        // 先読み分は同じ公開キューに積まれるため、要求分と合わせてキューに収まる数まで
+        tunables_.push_back(Tunable{"segment_window", "chunks prefetched on sequential access",
+            [this]() { return segments_->window(); },
+            [this](uint32_t value) {
+                if (value >= CeforeInterface::kPublishQueueSize) {
+                    return false;
+                }
+                segments_->setWindow(value);
+                return true;
+            }});
+    }
+}
+
+void MainController::reportStats(std::ostream& os) const {
+    GatewayFIB::LearnStats learn = fib_->learnStats();
+    GatewayFIB::FilterStats filter = fib_->filterStats();
+    os << "[fib] entries=" << fib_->size() << "/" << GatewayFIB::kCapacity
+       << " created=" << learn.created << " merged=" << learn.merged
+       << " refreshed=" << learn.refreshed << " skipped=" << learn.skipped
+       << " filter_rejected=" << filter.rejected << " filter_passed=" << filter.passed
+       << " false_positives=" << filter.falsePositives << "\n";
+
+    os << "[interest] forwarded=" << interests_forwarded_.load(std::memory_order_relaxed)
+       << " held=" << interests_held_.load(std::memory_order_relaxed) << "\n";
+
+    uart_->reportLink(os);
+    reassembler_->report(os);
+    if (dedup_) {
+        dedup_->report(os);
+    }
+
+    if (admission_) {
+        admission_->report(os);
+        admission_->reportOccupancy(os);
+    }
+    cefore_->reportPublishers(os);
+    cefore_->reportBacklog(os);
+    if (replicator_) {
+        replicator_->report(os);
+    }
+    if (segments_) {
+        segments_->report(os);
+    }
+    if (config_.realtime.enabled) {
+        reportJitter(os);
+    }
+    os << "[log] level=" << GatewayLog::toString(GatewayLog::level())
+       << " trace=" << (PacketTracer::enabled() ? "on" : "off") << "\n";
+}
+
+void MainController::reportJitter(std::ostream& os) const {
+    if (uart_) {
+        uart_->rxJitter().report(os, toString(GatewayThread::UartRx));
+        uart_->txJitter().report(os, toString(GatewayThread::UartTx));
+    }
+    if (cefore_) {
+        cefore_->rxJitter().report(os, toString(GatewayThread::CeforeRx));
     }
 }
 
 void MainController::shutdown() {
+    if (shut_down_) {
+        return;
+    }
+    shut_down_ = true;
+
     std::cout << "Shutting down gateway..." << std::endl;
 
     if (uart_) {
+        // ポートを閉じる前にカーネルのエラー計数を含めて出力
+        uart_->reportLink(std::cout);
         uart_->stop();
     }
+    if (capture_) {
+        capture_->close();
+        capture_->report(std::cout);
+    }
+    control_.reset();
+    if (replicator_) {
+        replicator_->stop();
+    }
 
     if (cefore_) {
         cefore_->stopReceiving();
+        cefore_->reportPublishers(std::cout);
+        cefore_->reportBacklog(std::cout);
         cefore_->disconnect();
     }
+
+    if (config_.realtime.enabled) {
+        reportJitter(std::cout);
+    }
+    if (admission_) {
+        admission_->report(std::cout);
+    }
+    if (fib_) {
+        GatewayFIB::LearnStats s = fib_->learnStats();
+        std::cout << "[fib] created=" << s.created << " merged=" << s.merged
+                  << " refreshed=" << s.refreshed << " skipped=" << s.skipped << std::endl;
+    }
+    if (replicator_) {
+        replicator_->report(std::cout);
+    }
+    if (reassembler_) {
+        reassembler_->report(std::cout);
+    }
+    if (dedup_) {
+        dedup_->report(std::cout);
+    }
+    if (segments_) {
+        segments_->report(std::cout);
+    }
 }
 
 void MainController::onRxPacket(const RxPacket& packet) {
-    PacketParser::SensorData data;
+    IcsnPacketView view;
+    char mac[MacAddress::kStringSize];
+    packet.sender_mac.format(mac);
 
-    if (!parser_->parse(packet.payload, data)) {
-        std::cerr << "Failed to parse packet from " << packet.sender_mac << std::endl;
+    if (!parser_->parse(packet.payload.data(), packet.payload.size(), view)) {
+        std::cerr << "Failed to parse packet from " << mac << std::endl;
         return;
     }
+    PacketTracer::mark(TraceStage::Parsed);
 
-    std::cout << "Received " << data.signal_code << " from " << packet.sender_mac
-              << ": " << data.content_name << " = " << data.content << std::endl;
+    // フラグメントフレームは再構築してから公開
+    if (view.signal() == IcsnSignal::Fragment) {
+        onFragment(packet, view);
+        return;
+    }
+
+    if (GatewayLog::enabled(LogLevel::Info)) {
+        std::cout << "Received " << toString(view.signal()) << " from " << mac
+                  << ": " << view.contentName() << " = " << view.content() << std::endl;
+    }
 
     // DATAパケットかチェック
-    if (std::string(data.signal_code) == "DATA") {
-        // FIBエントリ学習（content_name → MAC）
-        fib_->save(data.content_name, {packet.sender_mac});
+    if (view.signal() == IcsnSignal::Data) {
+        publishSensorData(view.contentName(), packet.sender_mac, view.hopCount(),
+                          view.contentData(), view.content().size());
+    }
+}
 
-        // コンテンツ名にタイムスタンプ付加
-        std::string timestamped_uri = name_mapper_->addTimestamp(data.content_name);
+void MainController::onFragment(const RxPacket& packet, const IcsnPacketView& fragment) {
+    if (!reassembler_->addFragment(packet.sender_mac, fragment,
+                                   reassembled_name_, reassembled_payload_)) {
+        return;
+    }
 
-        // CEFOREに公開
-        std::vector<uint8_t> payload(data.content, data.content + strlen(data.content));
-        if (cefore_->publishData(timestamped_uri, payload)) {
-            std::cout << "Published to CEFORE: " << timestamped_uri << std::endl;
-        } else {
-            std::cerr << "Failed to publish to CEFORE" << std::endl;
+    if (GatewayLog::enabled(LogLevel::Info)) {
+        char mac[MacAddress::kStringSize];
+        packet.sender_mac.format(mac);
+        std::cout << "Reassembled " << reassembled_payload_.size() << " bytes ("
+                  << static_cast<int>(fragment.fragmentCount()) << " fragments) from "
+                  << mac << ": " << reassembled_name_ << std::endl;
+    }
+
+    publishSensorData(reassembled_name_, packet.sender_mac, fragment.hopCount(),
+                      reassembled_payload_.data(), reassembled_payload_.size());
+}
+
+void MainController::learnRoute(std::string_view content_name, const MacAddress& sender_mac,
+                                const MacAddress* worse_mac) {
+    // 集約時は登録したプレフィックスを送る（受信側で同じ集約を前提にしない）
+    GatewayFIB::LearnResult result =
+        worse_mac ? fib_->replace(content_name, *worse_mac, sender_mac, &learned_name_)
+                  : fib_->learn(content_name, sender_mac, &learned_name_);
+
+    // 鮮度の更新は送らない（相手側の経路は消えないため、増えたときだけで足りる）
+    bool changed = result == GatewayFIB::LearnResult::Created ||
+                   result == GatewayFIB::LearnResult::Merged;
+    if (changed && GatewayLog::enabled(LogLevel::Debug)) {
+        std::cout << "Learned route " << learned_name_ << " -> " << sender_mac.toString()
+                  << (result == GatewayFIB::LearnResult::Merged ? " (merged)" : "") << std::endl;
+    }
+    if (changed && replicator_) {
+        replicator_->announce(learned_name_, sender_mac);
+    }
+}
+
+void MainController::publishSensorData(std::string_view content_name,
+                                       const MacAddress& sender_mac,
+                                       uint8_t hop_count,
+                                       const uint8_t* payload,
+                                       size_t payload_len) {
+    // メッシュの別経路から届いた同じ読み取り値は、FIB学習・公開の前に落とす
+    if (dedup_) {
+        MacAddress previous_mac;
+        DuplicateFilter::Result result = dedup_->check(content_name, payload, payload_len,
+                                                       hop_count, sender_mac, &previous_mac);
+        if (result == DuplicateFilter::Result::Duplicate) {
+            if (GatewayLog::enabled(LogLevel::Debug)) {
+                std::cout << "Suppressed duplicate: " << content_name << std::endl;
+            }
+            return;
         }
+        if (result == DuplicateFilter::Result::BetterPath) {
+            // より近い経路は学習だけして公開はしない（先に届いた遠い経路と置き換える）
+            learnRoute(content_name, sender_mac, &previous_mac);
+            return;
+        }
+    }
+
+    // FIBエントリ学習（content_name → MAC、既存の経路にマージ）
+    learnRoute(content_name, sender_mac);
+    PacketTracer::mark(TraceStage::FibDone);
+
+    // コンテンツ名にタイムスタンプ付加
+    uint64_t timestamp = name_mapper_->addTimestamp(content_name, publish_uri_);
+
+    // 正規化した名前（タイムスタンプを除いたURI）で履歴に記録
+    if (history_) {
+        std::string_view name(publish_uri_);
+        history_->record(name.substr(0, name.rfind('/')), timestamp, payload, payload_len);
+    }
+
+    uint32_t cache_time_sec = cache_time_sec_.load(std::memory_order_relaxed);
+    uint32_t expiry_sec = expiry_sec_.load(std::memory_order_relaxed);
+
+    // 1つに収まらない大きなデータは保持しておき、先頭チャンクだけ最終チャンク番号付きで公開する
+    // （後続はInterestのチャンク番号に応じて公開する）
+    uint32_t end_chunk = CeforeInterface::kNoEndChunk;
+    if (segments_ && !segments_->fitsInOne(payload_len)) {
+        end_chunk = segments_->put(publish_uri_, payload, payload_len, cache_time_sec, expiry_sec);
+        if (end_chunk != SegmentStore::kNone) {
+            payload_len = segments_->segmentSize();
+        }
+    }
+
+    // CEFOREに公開
+    if (cefore_->publishData(publish_uri_, payload, payload_len, 0,
+                             cache_time_sec, expiry_sec, end_chunk)) {
+        if (GatewayLog::enabled(LogLevel::Info)) {
+            std::cout << "Published to CEFORE: " << publish_uri_ << std::endl;
+        }
+    } else {
+        std::cerr << "Failed to publish to CEFORE" << std::endl;
     }
 }
 
 void MainController::onInterest(const std::string& uri, uint32_t chunk_num) {
-    std::cout << "Received Interest: " << uri << " (chunk=" << chunk_num << ")" << std::endl;
+    if (GatewayLog::enabled(LogLevel::Info)) {
+        std::cout << "Received Interest: " << uri << " (chunk=" << chunk_num << ")" << std::endl;
+    }
+
+    // 分割したデータの後続チャンクはゲートウェイが持っている
+    if (segments_ && answerFromSegments(uri, chunk_num)) {
+        return;
+    }
+
+    // 過去の計測値はセンサーを起こさずに履歴から返す
+    if (history_ && answerFromHistory(uri, chunk_num)) {
+        return;
+    }
 
     // タイムスタンプを除去してICSNコンテンツ名取得
     std::string content_name = name_mapper_->removeTimestamp(uri);
+    PacketTracer::mark(TraceStage::Parsed);
+
+    // 経路のある名前は転送できたかに関わらず人気度を記録する（先読み対象の候補）
+    // 過負荷で流量制御に止められた名前ほど要求が多いため、ここで数えないと上位から外れる
+    bool routable = false;
+    size_t sent = forwardInterest(content_name, SIZE_MAX, true, &routable);
+    if (!routable) {
+        return;
+    }
+    if (popularity_) {
+        popularity_->record(content_name);
+    }
+    if (sent > 0) {
+        interests_forwarded_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        interests_held_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool MainController::answerFromHistory(const std::string& uri, uint32_t chunk_num) {
+    size_t last_slash = uri.rfind('/');
+    if (last_slash == std::string::npos || last_slash == 0) {
+        return false;
+    }
+
+    SensorHistory::Query query;
+    if (!SensorHistory::parseQuery(std::string_view(uri).substr(last_slash + 1), query)) {
+        return false;
+    }
+
+    // 数値の末尾要素（/name/<ms>）も問い合わせとして扱い、その時刻の計測値が履歴にあれば
+    // 転送せずに答える（ゲートウェイ自身が同じ名前で公開した値なので、cefnetdのキャッシュから
+    // 消えた後も同じ内容を返せる）
+    std::string_view name = std::string_view(uri).substr(0, last_slash);
+    long len = history_->lookup(name, query, history_buff_.data(), history_buff_.size());
+    if (len < 0) {
+        // 履歴にない時刻はこれまで通りセンサーへ転送する
+        return false;
+    }
+
+    // latest/since=は内容が変わるため短時間だけキャッシュさせる
+    bool volatile_answer = query.kind == SensorHistory::Query::Kind::Latest ||
+                           query.kind == SensorHistory::Query::Kind::Since;
+    uint32_t cache_time_sec = volatile_answer ? 1 : 300;
+    uint32_t expiry_sec = volatile_answer ? 1 : 3600;
+
+    // 大きな範囲応答は分割して要求されたチャンクを返す
+    if (segments_ && !segments_->fitsInOne(static_cast<size_t>(len)) &&
+        segments_->put(uri, history_buff_.data(), static_cast<size_t>(len),
+                       cache_time_sec, expiry_sec) != SegmentStore::kNone) {
+        if (!answerFromSegments(uri, chunk_num)) {
+            std::cerr << "History answer has no chunk " << chunk_num << ": " << uri << std::endl;
+        }
+        return true;
+    }
 
+    if (cefore_->publishData(uri, history_buff_.data(), static_cast<size_t>(len),
+                             chunk_num, cache_time_sec, expiry_sec)) {
+        if (GatewayLog::enabled(LogLevel::Info)) {
+            std::cout << "Answered from history: " << uri << " (" << len << " bytes)" << std::endl;
+        }
+    } else {
+        std::cerr << "Failed to publish history answer: " << uri << std::endl;
+    }
+    return true;
+}
+
+bool MainController::answerFromSegments(const std::string& uri, uint32_t chunk_num) {
+    SegmentStore::Plan plan;
+    if (!segments_->request(uri, chunk_num, plan)) {
+        return false;
+    }
+
+    auto publish_chunk = [this, &uri, &plan](uint32_t chunk) {
+        long len = segments_->copy(uri, chunk, segment_buff_.data(), segment_buff_.size());
+        if (len < 0) {
+            // 要求と公開の間に追い出された
+            return false;
+        }
+        if (!cefore_->publishData(uri, segment_buff_.data(), static_cast<size_t>(len), chunk,
+                                  plan.cacheTimeSec, plan.expirySec, plan.endChunk)) {
+            std::cerr << "Failed to publish chunk " << chunk << ": " << uri << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // 要求されたチャンクの後に、順次取得なら先読み分を続けて公開する
+    uint32_t prefetched = 0;
+    if (publish_chunk(plan.chunk)) {
+        for (uint32_t chunk = plan.prefetchFrom; chunk <= plan.prefetchTo && publish_chunk(chunk); chunk++) {
+            prefetched++;
+        }
+    }
+
+    if (GatewayLog::enabled(LogLevel::Info)) {
+        std::cout << "Answered chunk " << chunk_num << "/" << plan.endChunk << ": " << uri;
+        if (prefetched > 0) {
+            std::cout << " (+" << prefetched << " prefetched)";
+        }
+        std::cout << std::endl;
+    }
+    return true;
+}
+
+size_t MainController::forwardInterest(std::string_view content_name, size_t max_sends,
+                                       bool deferrable, bool* routable) {
     // FIB検索（最長プレフィックス一致）
-    std::set<std::string> macs = fib_->lookup(content_name);
+    bool rejected_by_filter = false;
+    std::set<std::string> macs = fib_->lookup(content_name, &rejected_by_filter);
+    PacketTracer::mark(TraceStage::FibDone);
 
     if (macs.empty()) {
-        std::cout << "No FIB entry found for: " << content_name << std::endl;
-        return;
+        // 否定キャッシュで棄却された名前は統計のみ（スキャン等で大量に来るためログしない）
+        if (!rejected_by_filter && GatewayLog::enabled(LogLevel::Info)) {
+            std::cout << "No FIB entry found for: " << content_name << std::endl;
+        }
+        return 0;
+    }
+    if (routable) {
+        *routable = true;
     }
 
-    // ICSN Interestパケット作成
-    CommunicationData interest_packet;
-    memset(&interest_packet, 0, sizeof(interest_packet));
+    if (macs.size() > max_sends) {
+        return 0;
+    }
 
-    strncpy(interest_packet.signalCode, "INTEREST", 9);
-    interest_packet.hopCount = 1;
-    strncpy(interest_packet.contentName, content_name.c_str(), 99);
-    strncpy(interest_packet.content, "N/A", 19);
+    // ICSN Interestフレームを送信バッファ上に直接構築
+    uint8_t frame[IcsnPacketView::kMaxFrameSize];
+    size_t frame_len = IcsnFrameBuilder::buildInterest(frame, sizeof(frame), content_name, 1);
+    if (frame_len == 0) {
+        std::cerr << "Content name too long for ICSN frame: " << content_name << std::endl;
+        return 0;
+    }
+    PacketTracer::mark(TraceStage::FrameBuilt);
 
-    // バイナリにシリアライズ
-    std::vector<uint8_t> binary_data(sizeof(CommunicationData));
-    memcpy(binary_data.data(), &interest_packet, sizeof(CommunicationData));
+    // 保留中のInterestを先に送り、新しいInterestが補充されたトークンを先取りしないようにする
+    retryDeferredInterests();
 
     // 各MACアドレスにInterest転送
+    size_t sent = 0;
     for (const auto& mac : macs) {
-        if (uart_->sendTxCommand(mac, binary_data)) {
-            std::cout << "Forwarded Interest to " << mac << ": " << content_name << std::endl;
+        // 宛先を解釈できなければ流量制御を通せないため送らない
+        MacAddress dest;
+        if (!MacAddress::parse(mac, dest)) {
+            std::cerr << "Invalid next hop MAC in FIB: " << mac << std::endl;
+            continue;
+        }
+
+        // 流量制御（宛先MAC・プレフィックス・シリアル帯域）
+        if (admission_) {
+            size_t wire_bytes = UARTReceiver::txLineLength(mac.size(), frame_len);
+            auto decision = admission_->admit(dest, content_name, frame, frame_len,
+                                              wire_bytes, deferrable);
+            if (decision != AdmissionController::Decision::Admit) {
+                continue;
+            }
+        }
+
+        if (uart_->sendTxCommand(mac, frame, frame_len)) {
+            if (GatewayLog::enabled(LogLevel::Info)) {
+                std::cout << "Forwarded Interest to " << mac << ": " << content_name << std::endl;
+            }
+            sent++;
         } else {
             std::cerr << "Failed to forward Interest to " << mac << std::endl;
         }
     }
+    return sent;
+}
+
+void MainController::retryDeferredInterests() {
+    if (!admission_) {
+        return;
+    }
+    admission_->retryDeferred([this](const MacAddress& mac, const uint8_t* frame, size_t len) {
+        char text[MacAddress::kStringSize];
+        mac.format(text);
+        if (!uart_->sendTxCommand(std::string_view(text, MacAddress::kStringSize - 1), frame, len)) {
+            std::cerr << "Failed to send deferred Interest to " << text << std::endl;
+            return false;
+        }
+        return true;
+    });
+}
+
+void MainController::prefetchPopular() {
+    PopularityTracker::Entry top[PopularityTracker::kMaxTopK];
+    size_t count = popularity_->topK(top, PopularityTracker::kMaxTopK);
+
+    // 人気上位の名前からセンサーへInterestを送り、新しいDataを先にcefnetdへ載せる
+    // 送信数は周期ごとの予算で制限し、無線リンクを埋め尽くさないようにする
+    size_t budget = config_.prefetch.budget;
+    size_t prefetched = 0;
+
+    for (size_t i = 0; i < count && budget > 0; i++) {
+        if (top[i].estimate < config_.prefetch.min_requests) {
+            break;
+        }
+
+        // 先読みは消費者のInterestより優先度が低いため、超過時は保留せず捨てる
+        size_t sent = forwardInterest(top[i].name, budget, false);
+        budget -= sent;
+        if (sent > 0) {
+            prefetched++;
+        }
+    }
+
+    if (prefetched > 0 && GatewayLog::enabled(LogLevel::Info)) {
+        std::cout << "Prefetched " << prefetched << " popular name(s), "
+                  << (config_.prefetch.budget - budget) << " Interest(s) sent" << std::endl;
+    }
+
+    // 次の周期に向けて人気度を半減
+    popularity_->decay();
 }
@@ -1,6 +1,6 @@
 #include "name_mapper.h"
 #include <chrono>
-#include <sstream>
+#include <charconv>
 
 uint64_t NameMapper::getCurrentTimeMs() {
     auto now = std::chrono::system_clock::now();
@@ -9,28 +9,40 @@ uint64_t NameMapper::getCurrentTimeMs() {
     return ms.count();
 }
 
-std::string NameMapper::addTimestamp(const std::string& icsn_content_name) {
+std::string NameMapper::addTimestamp(std::string_view icsn_content_name) {
+    std::string out;
+    addTimestamp(icsn_content_name, out);
+    return out;
+}
+
+uint64_t NameMapper::addTimestamp(std::string_view icsn_content_name, std::string& out) {
     uint64_t timestamp = getCurrentTimeMs();
-    std::ostringstream oss;
+    out.clear();
 
     // コンテンツ名が'/'で始まることを保証
     if (icsn_content_name.empty() || icsn_content_name[0] != '/') {
-        oss << "/" << icsn_content_name;
-    } else {
-        oss << icsn_content_name;
+        out += '/';
     }
+    out += icsn_content_name;
 
     // 末尾の'/'があれば削除
-    std::string name = oss.str();
-    if (name.length() > 1 && name.back() == '/') {
-        name.pop_back();
+    if (out.length() > 1 && out.back() == '/') {
+        out.pop_back();
     }
 
     // タイムスタンプ付加
-    oss.str("");
-    oss << name << "/" << timestamp;
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), timestamp);
+    out += '/';
+    out.append(digits, result.ptr);
+    return timestamp;
+}
 
-    return oss.str();
+std::string_view NameMapper::stripScheme(std::string_view uri) {
+    if (uri.substr(0, 5) == "ccnx:") {
+        uri.remove_prefix(5);
+    }
+    return uri;
 }
 
 std::string NameMapper::removeTimestamp(const std::string& timestamped_name) {
@@ -0,0 +1,65 @@
+#include "packet_buffer_pool.h"
+
+PacketBuffer::PacketBuffer(PacketBuffer&& other) noexcept
+    : pool_(other.pool_), data_(other.data_), index_(other.index_), size_(other.size_) {
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.index_ = -1;
+    other.size_ = 0;
+}
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        index_ = other.index_;
+        size_ = other.size_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.index_ = -1;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+size_t PacketBuffer::capacity() const {
+    return data_ ? PacketBufferPool::kBufferSize : 0;
+}
+
+void PacketBuffer::release() {
+    if (pool_) {
+        pool_->release(index_);
+    }
+    pool_ = nullptr;
+    data_ = nullptr;
+    index_ = -1;
+    size_ = 0;
+}
+
+PacketBufferPool::PacketBufferPool() : freeCount_(kBufferCount), exhausted_(0) {
+    for (size_t i = 0; i < kBufferCount; i++) {
+        freeList_[i] = static_cast<int>(i);
+    }
+}
+
+PacketBuffer PacketBufferPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (freeCount_ == 0) {
+        exhausted_++;
+        return PacketBuffer();
+    }
+
+    int index = freeList_[--freeCount_];
+    return PacketBuffer(this, storage_[index], index);
+}
+
+size_t PacketBufferPool::available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return freeCount_;
+}
+
+void PacketBufferPool::release(int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeList_[freeCount_++] = index;
+}
@@ -1,33 +1,9 @@
 #include "packet_parser.h"
-#include <cstring>
 
-// ESP32のCommunicationData構造体（packed）
-struct __attribute__((packed)) CommunicationData {
-    char signalCode[10];
-    uint8_t hopCount;
-    char contentName[100];
-    char content[20];
-};
-
-bool PacketParser::parse(const std::vector<uint8_t>& raw_data, SensorData& output) {
-    if (raw_data.size() != sizeof(CommunicationData)) {
-        return false;
-    }
-
-    CommunicationData comm_data;
-    memcpy(&comm_data, raw_data.data(), sizeof(CommunicationData));
-
-    // 出力にコピー
-    strncpy(output.signal_code, comm_data.signalCode, 10);
-    output.signal_code[9] = '\0';
-
-    output.hop_count = comm_data.hopCount;
-
-    strncpy(output.content_name, comm_data.contentName, 100);
-    output.content_name[99] = '\0';
-
-    strncpy(output.content, comm_data.content, 20);
-    output.content[19] = '\0';
+bool PacketParser::parse(const uint8_t* raw_data, size_t len, IcsnPacketView& output) {
+    return output.decode(raw_data, len);
+}
 
-    return true;
+bool PacketParser::parse(const std::vector<uint8_t>& raw_data, IcsnPacketView& output) {
+    return parse(raw_data.data(), raw_data.size(), output);
 }
@@ -0,0 +1,110 @@
+#include "packet_tracer.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+std::atomic<bool> PacketTracer::enabled_(false);
+std::atomic<uint32_t> PacketTracer::nextId_(1);
+std::atomic<uint64_t> PacketTracer::writeIndex_(0);
+PacketTracer::Event PacketTracer::ring_[PacketTracer::kRingSize];
+thread_local uint32_t PacketTracer::currentId_ = 0;
+
+static_assert((PacketTracer::kRingSize & (PacketTracer::kRingSize - 1)) == 0,
+              "kRingSize must be a power of two");
+
+static const char* stageName(uint8_t stage) {
+    switch (static_cast<TraceStage>(stage)) {
+        case TraceStage::Received: return "received";
+        case TraceStage::Decoded: return "decoded";
+        case TraceStage::Parsed: return "parsed";
+        case TraceStage::FibDone: return "fib";
+        case TraceStage::FrameBuilt: return "frame_built";
+        case TraceStage::Written: return "written";
+        default: return "unknown";
+    }
+}
+
+static uint32_t currentTid() {
+    static thread_local uint32_t tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void PacketTracer::record(uint32_t id, TraceStage stage) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t index = writeIndex_.fetch_add(1, std::memory_order_relaxed);
+    Event& event = ring_[index & (kRingSize - 1)];
+
+    event.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.timestampNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    event.id = id;
+    event.tid = currentTid();
+    event.stage = static_cast<uint8_t>(stage);
+    event.seq.store(index + 1, std::memory_order_release);
+}
+
+bool PacketTracer::dump(const std::string& path) {
+    struct Snapshot {
+        uint64_t timestampNs;
+        uint32_t id;
+        uint32_t tid;
+        uint8_t stage;
+    };
+
+    // 書き込み途中のイベントは通し番号が一致しないので捨てる
+    std::vector<Snapshot> events;
+    events.reserve(kRingSize);
+    for (auto& event : ring_) {
+        uint64_t seq = event.seq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            continue;
+        }
+        Snapshot snap{event.timestampNs, event.id, event.tid, event.stage};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) == seq) {
+            events.push_back(snap);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Snapshot& a, const Snapshot& b) {
+        return a.id != b.id ? a.id < b.id : a.timestampNs < b.timestampNs;
+    });
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open trace file: " << path << std::endl;
+        return false;
+    }
+
+    // 同じパケットの連続する段階を1つのスパン（"X"イベント）にする
+    // pidを経路（1: ICSN→CEFORE, 2: CEFORE→ICSN）として使う
+    out << "{\"traceEvents\":[\n"
+        << "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"ICSN->CEFORE\"}},\n"
+        << "{\"ph\":\"M\",\"pid\":2,\"name\":\"process_name\",\"args\":{\"name\":\"CEFORE->ICSN\"}}";
+
+    size_t spans = 0;
+    for (size_t i = 1; i < events.size(); i++) {
+        const Snapshot& prev = events[i - 1];
+        const Snapshot& cur = events[i];
+        if (prev.id != cur.id) {
+            continue;
+        }
+
+        out << ",\n{\"ph\":\"X\",\"name\":\"" << stageName(cur.stage) << "\""
+            << ",\"pid\":" << (cur.id & 3) << ",\"tid\":" << cur.tid
+            << ",\"ts\":" << prev.timestampNs / 1000 << "." << (prev.timestampNs % 1000) / 100
+            << ",\"dur\":" << (cur.timestampNs - prev.timestampNs) / 1000.0
+            << ",\"args\":{\"packet\":" << (cur.id >> 2) << "}}";
+        spans++;
+    }
+    out << "\n]}\n";
+
+    std::cout << "Trace written to " << path << " (" << spans << " spans)" << std::endl;
+    return true;
+}
@@ -0,0 +1,108 @@
+#include "popularity_tracker.h"
+#include "infrastructure/data_access/FixedSizeLRUCache.hpp"
+#include <algorithm>
+#include <cstring>
+
+PopularityTracker::PopularityTracker(size_t top_k)
+    : topCount_(0), topLimit_(std::min(top_k, kMaxTopK)) {
+    memset(sketch_, 0, sizeof(sketch_));
+}
+
+void PopularityTracker::hashes(std::string_view name, uint64_t* out) {
+    // 1つの64bitハッシュから行ごとのハッシュを派生させる
+    uint64_t h = CacheKeyHasher()(name);
+    for (size_t row = 0; row < kDepth; row++) {
+        out[row] = CacheKeyHasher::mix(h + row * 0x9E3779B97F4A7C15ULL);
+    }
+}
+
+uint32_t PopularityTracker::estimateLocked(const uint64_t* row_hashes) const {
+    uint32_t result = UINT32_MAX;
+    for (size_t row = 0; row < kDepth; row++) {
+        result = std::min(result, sketch_[row][row_hashes[row] % kWidth]);
+    }
+    return result;
+}
+
+void PopularityTracker::record(std::string_view name) {
+    if (name.empty() || name.size() >= kMaxNameSize) {
+        return;
+    }
+
+    uint64_t row_hashes[kDepth];
+    hashes(name, row_hashes);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Conservative update: 最小値の行だけを増やし過大評価を抑える
+    uint32_t current = estimateLocked(row_hashes);
+    for (size_t row = 0; row < kDepth; row++) {
+        uint32_t& counter = sketch_[row][row_hashes[row] % kWidth];
+        if (counter == current && counter != UINT32_MAX) {
+            counter++;
+        }
+    }
+    uint32_t updated = estimateLocked(row_hashes);
+
+    // 上位K件の更新
+    size_t min_index = 0;
+    for (size_t i = 0; i < topCount_; i++) {
+        if (name == top_[i].name) {
+            top_[i].estimate = updated;
+            return;
+        }
+        if (top_[i].estimate < top_[min_index].estimate) {
+            min_index = i;
+        }
+    }
+
+    size_t index;
+    if (topCount_ < topLimit_) {
+        index = topCount_++;
+    } else if (topLimit_ > 0 && updated > top_[min_index].estimate) {
+        index = min_index;
+    } else {
+        return;
+    }
+
+    memcpy(top_[index].name, name.data(), name.size());
+    top_[index].name[name.size()] = '\0';
+    top_[index].estimate = updated;
+}
+
+size_t PopularityTracker::topK(Entry* out, size_t max) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t count = std::min(max, topCount_);
+    std::partial_sort_copy(top_, top_ + topCount_, out, out + count,
+                           [](const Entry& a, const Entry& b) { return a.estimate > b.estimate; });
+    return count;
+}
+
+void PopularityTracker::decay() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& row : sketch_) {
+        for (auto& counter : row) {
+            counter >>= 1;
+        }
+    }
+
+    // 推定値が0になった名前は上位から外す
+    size_t kept = 0;
+    for (size_t i = 0; i < topCount_; i++) {
+        top_[i].estimate >>= 1;
+        if (top_[i].estimate > 0) {
+            top_[kept++] = top_[i];
+        }
+    }
+    topCount_ = kept;
+}
+
+uint32_t PopularityTracker::estimate(std::string_view name) const {
+    uint64_t row_hashes[kDepth];
+    hashes(name, row_hashes);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return estimateLocked(row_hashes);
+}
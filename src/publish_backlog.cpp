@@ -0,0 +1,178 @@
+#include "publish_backlog.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 退避ファイル1件のヘッダ
+struct __attribute__((packed)) SpillHeader {
+    uint64_t createdMs;
+    uint32_t chunkNum;
+    uint32_t endChunkNum;
+    uint32_t cacheTimeSec;
+    uint32_t expirySec;
+    uint16_t uriLen;
+    uint32_t payloadLen;
+};
+
+PublishBacklog::PublishBacklog(const BacklogConfig& config)
+    : config_(config), ring_(config.capacity > 0 ? config.capacity : 1),
+      head_(0), count_(0), fd_(-1), readOffset_(0), writeOffset_(0), fileCount_(0) {
+    if (config_.path.empty()) {
+        return;
+    }
+
+    // 前回の退避分は起動時に破棄する（期限切れの可能性が高く、順序も保証できない）
+    fd_ = open(config_.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Error opening backlog file " << config_.path << ": " << strerror(errno) << std::endl;
+    }
+}
+
+PublishBacklog::~PublishBacklog() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+uint64_t PublishBacklog::nowMs() {
+    auto now = std::chrono::system_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+bool PublishBacklog::push(std::string_view uri, const uint8_t* payload, size_t payload_len,
+                          uint32_t chunk_num, uint32_t cache_time_sec, uint32_t expiry_sec,
+                          uint32_t end_chunk_num) {
+    if (uri.size() > kMaxUriSize || payload_len > kMaxPayload) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.queued++;
+
+    // ファイルに退避済みのものがあれば、順序を保つため後続もファイルへ
+    bool use_file = fileCount_ > 0 || count_ == ring_.size();
+    Entry* entry;
+    Entry spill;
+
+    if (!use_file) {
+        entry = &tailSlotLocked();
+    } else {
+        entry = &spill;
+    }
+
+    entry->createdMs = nowMs();
+    entry->chunkNum = chunk_num;
+    entry->endChunkNum = end_chunk_num;
+    entry->cacheTimeSec = cache_time_sec;
+    entry->expirySec = expiry_sec;
+    entry->uriLen = static_cast<uint16_t>(uri.size());
+    entry->payloadLen = static_cast<uint32_t>(payload_len);
+    memcpy(entry->uri, uri.data(), uri.size());
+    memcpy(entry->payload, payload, payload_len);
+
+    if (!use_file) {
+        count_++;
+        return true;
+    }
+
+    if (spillLocked(spill)) {
+        stats_.spilled++;
+        return true;
+    }
+
+    // 退避できない場合
+    stats_.dropped++;
+    if (fileCount_ > 0) {
+        // ファイル上限: ファイルの方がメモリより新しいので、今回の1件を捨てるしかない
+        return false;
+    }
+    // メモリ上の最も古い1件を上書きする（満杯なのでhead_の位置が末尾になる）
+    ring_[head_] = spill;
+    head_ = (head_ + 1) % ring_.size();
+    return true;
+}
+
+bool PublishBacklog::spillLocked(const Entry& entry) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    size_t record_size = sizeof(SpillHeader) + entry.uriLen + entry.payloadLen;
+    if (writeOffset_ - readOffset_ + record_size > config_.max_file_bytes) {
+        return false;
+    }
+
+    SpillHeader header{entry.createdMs, entry.chunkNum, entry.endChunkNum, entry.cacheTimeSec,
+                       entry.expirySec, entry.uriLen, entry.payloadLen};
+    if (pwrite(fd_, &header, sizeof(header), writeOffset_) != sizeof(header) ||
+        pwrite(fd_, entry.uri, entry.uriLen, writeOffset_ + sizeof(header)) != entry.uriLen ||
+        pwrite(fd_, entry.payload, entry.payloadLen,
+               writeOffset_ + sizeof(header) + entry.uriLen) != static_cast<ssize_t>(entry.payloadLen)) {
+        std::cerr << "Backlog spill write failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    writeOffset_ += record_size;
+    fileCount_++;
+    return true;
+}
+
+bool PublishBacklog::unspillLocked(Entry& entry) {
+    SpillHeader header;
+    if (pread(fd_, &header, sizeof(header), readOffset_) != sizeof(header) ||
+        header.uriLen > kMaxUriSize || header.payloadLen > kMaxPayload) {
+        return false;
+    }
+
+    uint64_t offset = readOffset_ + sizeof(header);
+    if (pread(fd_, entry.uri, header.uriLen, offset) != header.uriLen ||
+        pread(fd_, entry.payload, header.payloadLen, offset + header.uriLen) !=
+            static_cast<ssize_t>(header.payloadLen)) {
+        return false;
+    }
+
+    entry.createdMs = header.createdMs;
+    entry.chunkNum = header.chunkNum;
+    entry.endChunkNum = header.endChunkNum;
+    entry.cacheTimeSec = header.cacheTimeSec;
+    entry.expirySec = header.expirySec;
+    entry.uriLen = header.uriLen;
+    entry.payloadLen = header.payloadLen;
+    readOffset_ = offset + header.uriLen + header.payloadLen;
+    return true;
+}
+
+void PublishBacklog::refillFromFileLocked() {
+    while (fileCount_ > 0 && count_ < ring_.size()) {
+        if (!unspillLocked(tailSlotLocked())) {
+            // 読めない退避ファイルは残りを捨てる
+            std::cerr << "Backlog spill file corrupted, discarding " << fileCount_ << " entries" << std::endl;
+            stats_.dropped += fileCount_;
+            fileCount_ = 0;
+            break;
+        }
+        count_++;
+        fileCount_--;
+    }
+
+    // 空になったらファイルを切り詰めて先頭から使い直す
+    if (fileCount_ == 0 && writeOffset_ > 0) {
+        readOffset_ = 0;
+        writeOffset_ = 0;
+        if (ftruncate(fd_, 0) != 0) {
+            std::cerr << "Backlog spill truncate failed: " << strerror(errno) << std::endl;
+        }
+    }
+}
+
+size_t PublishBacklog::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_ + fileCount_;
+}
+
+PublishBacklog::Stats PublishBacklog::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
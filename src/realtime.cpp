@@ -0,0 +1,140 @@
+#include "realtime.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <alloca.h>
+#include <time.h>
+
+const char* toString(GatewayThread thread) {
+    switch (thread) {
+        case GatewayThread::UartRx: return "uart-rx";
+        case GatewayThread::UartTx: return "uart-tx";
+        case GatewayThread::CeforeRx: return "cefore-rx";
+        default: return "unknown";
+    }
+}
+
+bool Realtime::lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "mlockall failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Realtime::prefaultStack(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    // 最適化で消されないようvolatile経由で書き込む
+    volatile unsigned char* stack = static_cast<unsigned char*>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+bool Realtime::applyToCurrentThread(const RealtimeConfig& config, GatewayThread thread) {
+    if (!config.enabled) {
+        return true;
+    }
+
+    size_t index = static_cast<size_t>(thread);
+    bool ok = true;
+
+    pthread_setname_np(pthread_self(), toString(thread));
+
+    if (config.cpu[index] >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu[index], &set);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (res != 0) {
+            std::cerr << "Failed to pin " << toString(thread) << " to CPU "
+                      << config.cpu[index] << ": " << strerror(res) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (config.priority[index] > 0) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = config.priority[index];
+        int res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (res != 0) {
+            std::cerr << "Failed to set SCHED_FIFO(" << config.priority[index] << ") for "
+                      << toString(thread) << ": " << strerror(res) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (config.lock_memory) {
+        prefaultStack(config.prefault_stack_bytes);
+    }
+
+    return ok;
+}
+
+JitterProbe::JitterProbe() {
+    reset();
+}
+
+uint64_t JitterProbe::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void JitterProbe::record(uint64_t latency_ns) {
+    size_t bucket = latency_ns / kBucketWidthNs;
+    if (bucket >= kBucketCount) {
+        bucket = kBucketCount - 1;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (latency_ns > prev &&
+           !max_.compare_exchange_weak(prev, latency_ns, std::memory_order_relaxed)) {
+    }
+}
+
+void JitterProbe::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t JitterProbe::percentileNs(double p) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(p * total);
+    if (target >= total) {
+        target = total - 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            uint64_t upper = (i + 1) * kBucketWidthNs;
+            return (i == kBucketCount - 1 || upper > maxNs()) ? maxNs() : upper;
+        }
+    }
+    return maxNs();
+}
+
+void JitterProbe::report(std::ostream& os, const char* name) const {
+    os << name << " wakeup latency: samples=" << count()
+       << " p50=" << percentileNs(0.50) / 1000 << "us"
+       << " p99=" << percentileNs(0.99) / 1000 << "us"
+       << " p99.9=" << percentileNs(0.999) / 1000 << "us"
+       << " max=" << maxNs() / 1000 << "us" << std::endl;
+}
@@ -0,0 +1,160 @@
+#include "segment_store.h"
+#include "name_mapper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+SegmentStore::SegmentStore(const SegmentConfig& config) : config_(config), objects_(kMaxObjects) {}
+
+uint64_t SegmentStore::nowMs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+SegmentStore::Object* SegmentStore::findLocked(std::string_view name, uint64_t now_ms) {
+    name = NameMapper::stripScheme(name);
+    for (Object& object : objects_) {
+        if (!object.name.empty() && now_ms < object.expiresMs && object.name == name) {
+            return &object;
+        }
+    }
+    return nullptr;
+}
+
+const SegmentStore::Object* SegmentStore::findLocked(std::string_view name, uint64_t now_ms) const {
+    return const_cast<SegmentStore*>(this)->findLocked(name, now_ms);
+}
+
+uint32_t SegmentStore::put(std::string_view name, const uint8_t* data, size_t len,
+                           uint32_t cache_time_sec, uint32_t expiry_sec) {
+    if (len == 0 || len > kMaxObjectSize) {
+        return kNone;
+    }
+    name = NameMapper::stripScheme(name);
+    uint64_t now_ms = nowMs();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 同じ名前 → 空き・期限切れ → 最も長く使われていないもの の順に置き場所を選ぶ
+    Object* slot = nullptr;
+    Object* oldest = nullptr;
+    for (Object& object : objects_) {
+        if (object.name == name) {
+            slot = &object;
+            break;
+        }
+        if (!slot && (object.name.empty() || now_ms >= object.expiresMs)) {
+            slot = &object;
+        }
+        if (!oldest || object.lastAccessMs < oldest->lastAccessMs) {
+            oldest = &object;
+        }
+    }
+    if (!slot) {
+        slot = oldest;
+        stats_.evicted++;
+    }
+
+    slot->name.assign(name);
+    slot->data.assign(data, data + len);
+    slot->endChunk = static_cast<uint32_t>((len - 1) / config_.segment_size);
+    slot->cacheTimeSec = cache_time_sec;
+    slot->expirySec = expiry_sec;
+    // cefnetdのキャッシュに残っている間だけ応じる（それ以降の要求は転送に回す）
+    slot->expiresMs = now_ms + std::max<uint64_t>(cache_time_sec, 1) * 1000;
+    slot->lastAccessMs = now_ms;
+    slot->lastRequested = kNone;
+    slot->publishedUpTo = kNone;
+    stats_.stored++;
+    return slot->endChunk;
+}
+
+bool SegmentStore::request(std::string_view name, uint32_t chunk, Plan& plan) {
+    uint64_t now_ms = nowMs();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Object* object = findLocked(name, now_ms);
+    if (!object) {
+        return false;
+    }
+    stats_.requests++;
+    if (chunk > object->endChunk) {
+        stats_.misses++;
+        return false;
+    }
+    object->lastAccessMs = now_ms;
+
+    // 直前の要求の続き（または先読み済みの範囲内で前進）なら順次取得
+    bool sequential = object->lastRequested != kNone && chunk > object->lastRequested &&
+                      (chunk == object->lastRequested + 1 ||
+                       (object->publishedUpTo != kNone && chunk <= object->publishedUpTo + 1));
+    object->lastRequested = chunk;
+
+    plan.endChunk = object->endChunk;
+    plan.cacheTimeSec = object->cacheTimeSec;
+    plan.expirySec = object->expirySec;
+    plan.chunk = chunk;
+    plan.prefetchFrom = 1;
+    plan.prefetchTo = 0;
+
+    if (sequential) {
+        stats_.sequential++;
+        uint32_t from = object->publishedUpTo == kNone ? chunk + 1
+                                                       : std::max(chunk, object->publishedUpTo) + 1;
+        uint32_t to = static_cast<uint32_t>(
+            std::min<uint64_t>(static_cast<uint64_t>(chunk) + config_.window, object->endChunk));
+        if (from <= to) {
+            plan.prefetchFrom = from;
+            plan.prefetchTo = to;
+            stats_.prefetched += to - from + 1;
+        }
+    }
+
+    // 飛び飛びの要求では公開済みの位置を進めない（間のチャンクの先読みを飛ばさない）
+    uint32_t published = plan.prefetchFrom <= plan.prefetchTo ? plan.prefetchTo : chunk;
+    bool contiguous = sequential ||
+                      (object->publishedUpTo == kNone ? chunk == 0 : chunk <= object->publishedUpTo + 1);
+    if (contiguous && (object->publishedUpTo == kNone || published > object->publishedUpTo)) {
+        object->publishedUpTo = published;
+    }
+    return true;
+}
+
+long SegmentStore::copy(std::string_view name, uint32_t chunk, uint8_t* out, size_t capacity) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const Object* object = findLocked(name, nowMs());
+    if (!object || chunk > object->endChunk) {
+        return -1;
+    }
+
+    size_t offset = static_cast<size_t>(chunk) * config_.segment_size;
+    size_t len = std::min(config_.segment_size, object->data.size() - offset);
+    if (len > capacity) {
+        return -1;
+    }
+    memcpy(out, object->data.data() + offset, len);
+    return static_cast<long>(len);
+}
+
+uint32_t SegmentStore::window() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_.window;
+}
+
+void SegmentStore::setWindow(uint32_t window) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_.window = window;
+}
+
+SegmentStore::Stats SegmentStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void SegmentStore::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "[segment] stored=" << s.stored << " requests=" << s.requests
+       << " sequential=" << s.sequential << " prefetched=" << s.prefetched
+       << " misses=" << s.misses << " evicted=" << s.evicted << "\n";
+}
@@ -0,0 +1,224 @@
+#include "sensor_history.h"
+#include "name_mapper.h"
+#include <iostream>
+#include <cstring>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert((SensorHistory::kSamplesPerSeries & (SensorHistory::kSamplesPerSeries - 1)) == 0,
+              "kSamplesPerSeries must be a power of two");
+
+SensorHistory::SensorHistory() : store_(nullptr), fd_(-1) {}
+
+SensorHistory::~SensorHistory() {
+    if (store_) {
+        if (fd_ >= 0) {
+            msync(store_, sizeof(Store), MS_ASYNC);
+        }
+        munmap(store_, sizeof(Store));
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool SensorHistory::open(const std::string& path) {
+    void* mem;
+
+    if (path.empty()) {
+        mem = mmap(nullptr, sizeof(Store), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) {
+            std::cerr << "Error opening history file " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        if (ftruncate(fd_, sizeof(Store)) != 0) {
+            std::cerr << "Error sizing history file: " << strerror(errno) << std::endl;
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        mem = mmap(nullptr, sizeof(Store), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+
+    if (mem == MAP_FAILED) {
+        std::cerr << "History mmap failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    store_ = static_cast<Store*>(mem);
+
+    // 新規ファイル（ゼロ埋め）やレイアウトの異なるファイルは初期化し直す
+    if (store_->magic != kMagic || store_->layout != kLayout) {
+        memset(store_, 0, sizeof(Store));
+        store_->magic = kMagic;
+        store_->layout = kLayout;
+    }
+    rebuildIndex();
+
+    if (!path.empty()) {
+        std::cout << "Sensor history: " << path << " (" << index_.size() << " series restored)" << std::endl;
+    }
+    return true;
+}
+
+void SensorHistory::rebuildIndex() {
+    index_.clear();
+    for (size_t i = 0; i < kMaxSeries; i++) {
+        Series& series = store_->series[i];
+        if (!series.inUse) {
+            continue;
+        }
+        if (series.nameLen == 0 || series.nameLen >= kMaxNameSize ||
+            series.count > kSamplesPerSeries || series.head >= kSamplesPerSeries) {
+            // 壊れたエントリは捨てる
+            memset(&series, 0, sizeof(Series));
+            continue;
+        }
+        index_.put(std::string_view(series.name, series.nameLen), static_cast<int>(i));
+    }
+}
+
+int SensorHistory::allocateSeries(std::string_view name) {
+    int victim = -1;
+    for (size_t i = 0; i < kMaxSeries; i++) {
+        const Series& series = store_->series[i];
+        if (!series.inUse) {
+            victim = static_cast<int>(i);
+            break;
+        }
+        if (victim < 0 || series.lastWriteMs < store_->series[victim].lastWriteMs) {
+            victim = static_cast<int>(i);
+        }
+    }
+
+    Series& series = store_->series[victim];
+    if (series.inUse) {
+        index_.remove(std::string_view(series.name, series.nameLen));
+    }
+
+    series.inUse = 1;
+    series.nameLen = static_cast<uint8_t>(name.size());
+    memcpy(series.name, name.data(), name.size());
+    series.head = 0;
+    series.count = 0;
+    index_.put(name, victim);
+    return victim;
+}
+
+void SensorHistory::record(std::string_view name, uint64_t timestamp_ms,
+                           const uint8_t* value, size_t len) {
+    name = NameMapper::stripScheme(name);
+    if (!store_ || name.empty() || name.size() >= kMaxNameSize || len > kValueStride) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int* found = index_.peek(name);
+    int index = found ? *found : allocateSeries(name);
+
+    Series& series = store_->series[index];
+    uint32_t pos = series.head;
+    series.timestamps[pos] = timestamp_ms;
+    series.lengths[pos] = static_cast<uint8_t>(len);
+    memcpy(series.values[pos], value, len);
+    series.head = (pos + 1) & (kSamplesPerSeries - 1);
+    if (series.count < kSamplesPerSeries) {
+        series.count++;
+    }
+    series.lastWriteMs = timestamp_ms;
+}
+
+bool SensorHistory::parseQuery(std::string_view component, Query& query) {
+    auto parseTs = [](std::string_view text, uint64_t& out) {
+        const char* end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, out);
+        return !text.empty() && result.ec == std::errc() && result.ptr == end;
+    };
+
+    if (component == "latest") {
+        query.kind = Query::Kind::Latest;
+        return true;
+    }
+    if (component.substr(0, 6) == "since=") {
+        query.kind = Query::Kind::Since;
+        query.to = UINT64_MAX;
+        return parseTs(component.substr(6), query.from);
+    }
+    if (component.substr(0, 6) == "range=") {
+        std::string_view range = component.substr(6);
+        size_t dash = range.find('-');
+        query.kind = Query::Kind::Range;
+        return dash != std::string_view::npos &&
+               parseTs(range.substr(0, dash), query.from) &&
+               parseTs(range.substr(dash + 1), query.to) &&
+               query.from <= query.to;
+    }
+
+    query.kind = Query::Kind::Exact;
+    if (!parseTs(component, query.from)) {
+        return false;
+    }
+    query.to = query.from;
+    return true;
+}
+
+long SensorHistory::lookup(std::string_view name, const Query& query,
+                           uint8_t* out, size_t capacity) const {
+    name = NameMapper::stripScheme(name);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int* found = store_ ? index_.peek(name) : nullptr;
+    if (!found) {
+        return -1;
+    }
+
+    const Series& series = store_->series[*found];
+    const uint32_t mask = kSamplesPerSeries - 1;
+    // 最古の値の位置
+    const uint32_t oldest = (series.head - series.count) & mask;
+
+    if (query.kind == Query::Kind::Latest || query.kind == Query::Kind::Exact) {
+        // 新しい方から探す
+        for (uint32_t i = 0; i < series.count; i++) {
+            uint32_t pos = (series.head - 1 - i) & mask;
+            if (query.kind == Query::Kind::Latest || series.timestamps[pos] == query.from) {
+                size_t len = series.lengths[pos];
+                if (len > capacity) {
+                    return -1;
+                }
+                memcpy(out, series.values[pos], len);
+                return static_cast<long>(len);
+            }
+        }
+        return -1;
+    }
+
+    // 古い順に列挙（時刻列だけを走査し、該当した行の値だけを読む）
+    size_t written = 0;
+    for (uint32_t i = 0; i < series.count; i++) {
+        uint32_t pos = (oldest + i) & mask;
+        uint64_t ts = series.timestamps[pos];
+        if (ts < query.from || ts > query.to) {
+            continue;
+        }
+
+        size_t len = series.lengths[pos];
+        if (written + kRecordHeaderSize + len > capacity) {
+            break;
+        }
+        for (int b = 0; b < 8; b++) {
+            out[written++] = static_cast<uint8_t>(ts >> (8 * b));
+        }
+        out[written++] = static_cast<uint8_t>(len);
+        memcpy(out + written, series.values[pos], len);
+        written += len;
+    }
+    return static_cast<long>(written);
+}
+
+size_t SensorHistory::seriesCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
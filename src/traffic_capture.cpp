@@ -0,0 +1,181 @@
+#include "traffic_capture.h"
+#include "realtime.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr uint16_t kCaptureVersion = 1;
+
+TrafficCapture::TrafficCapture()
+    : fd_(-1), max_bytes_(kDefaultMaxBytes), running_(false), reserved_bytes_(0) {}
+
+TrafficCapture::~TrafficCapture() {
+    close();
+}
+
+bool TrafficCapture::open(const std::string& path, uint64_t max_bytes) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Error opening capture file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    memcpy(header.magic, "ICAP", 4);
+    header.version = kCaptureVersion;
+    header.reserved = 0;
+    header.startRealtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (write(fd_, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+        std::cerr << "Error writing capture file " << path << ": " << strerror(errno) << std::endl;
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    max_bytes_ = max_bytes;
+    reserved_bytes_ = sizeof(header);
+    active_.reserve(kBufferSize);
+    spare_.reserve(kBufferSize);
+
+    running_ = true;
+    writer_ = std::thread(&TrafficCapture::writerLoop, this);
+    std::cout << "Capturing UART traffic to " << path << std::endl;
+    return true;
+}
+
+void TrafficCapture::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void TrafficCapture::record(Direction direction, const char* line, size_t len) {
+    if (len > kMaxLineSize) {
+        len = kMaxLineSize;
+    }
+
+    RecordHeader header;
+    header.timestampNs = JitterProbe::nowNs();
+    header.direction = static_cast<uint8_t>(direction);
+    header.reserved = 0;
+    header.length = static_cast<uint16_t>(len);
+    size_t size = sizeof(header) + len;
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_ || active_.size() + size > kBufferSize || reserved_bytes_ + size > max_bytes_) {
+            stats_.dropped++;
+            return;
+        }
+
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+        active_.insert(active_.end(), h, h + sizeof(header));
+        active_.insert(active_.end(), line, line + len);
+        reserved_bytes_ += size;
+        stats_.records++;
+        stats_.bytes += size;
+
+        // 半分を超えたらライターを起こす（それ以外は周期的な起床に任せる）
+        wake = active_.size() >= kBufferSize / 2 && active_.size() - size < kBufferSize / 2;
+    }
+    if (wake) {
+        cv_.notify_one();
+    }
+}
+
+void TrafficCapture::writerLoop() {
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(200), [this] {
+                return !running_ || active_.size() >= kBufferSize / 2;
+            });
+            stopping = !running_;
+            active_.swap(spare_);
+        }
+
+        // ロックの外で書き出す（その間も記録側はもう一方の面へ追記できる）
+        size_t offset = 0;
+        while (offset < spare_.size()) {
+            ssize_t written = write(fd_, spare_.data() + offset, spare_.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Capture write error: " << strerror(errno) << std::endl;
+                break;
+            }
+            offset += static_cast<size_t>(written);
+        }
+        spare_.clear();
+
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+TrafficCapture::Stats TrafficCapture::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void TrafficCapture::report(std::ostream& os) const {
+    Stats s = stats();
+    os << "[capture] records=" << s.records << " bytes=" << s.bytes
+       << " dropped=" << s.dropped << std::endl;
+}
+
+TrafficCapture::Reader::~Reader() {
+    if (file_) {
+        fclose(file_);
+    }
+}
+
+bool TrafficCapture::Reader::open(const std::string& path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) {
+        std::cerr << "Error opening capture file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1 || memcmp(header.magic, "ICAP", 4) != 0 ||
+        header.version != kCaptureVersion) {
+        std::cerr << "Not a UART capture file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TrafficCapture::Reader::next(Record& record) {
+    RecordHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1) {
+        return false;
+    }
+    if (header.length > kMaxLineSize || header.direction > static_cast<uint8_t>(Direction::Tx) ||
+        fread(line_, 1, header.length, file_) != header.length) {
+        std::cerr << "Truncated or corrupt capture record" << std::endl;
+        return false;
+    }
+
+    record.timestampNs = header.timestampNs;
+    record.direction = static_cast<Direction>(header.direction);
+    record.line = std::string_view(line_, header.length);
+    return true;
+}
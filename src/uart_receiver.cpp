@@ -1,25 +1,125 @@
 #include "uart_receiver.h"
-#include "third_party/base64.h"
+#include "packet_tracer.h"
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
-#include <sstream>
+#include <poll.h>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+
+// Base64をバッファへ直接デコードする（ヒープ確保なし）
+// 成功時はデコード後の長さ、失敗時は-1を返す
+static ssize_t decodeBase64(std::string_view in, uint8_t* out, size_t capacity) {
+    static const auto table = [] {
+        struct { int8_t v[256]; } t;
+        for (int i = 0; i < 256; i++) t.v[i] = -1;
+        const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) t.v[static_cast<uint8_t>(chars[i])] = static_cast<int8_t>(i);
+        t.v[static_cast<uint8_t>('-')] = 62;  // URLセーフ
+        t.v[static_cast<uint8_t>('_')] = 63;
+        return t;
+    }();
+
+    while (!in.empty() && in.back() == '=') {
+        in.remove_suffix(1);
+    }
+
+    size_t out_len = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in) {
+        int8_t v = table.v[static_cast<uint8_t>(c)];
+        if (v < 0) {
+            return -1;
+        }
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (out_len >= capacity) {
+                return -1;
+            }
+            out[out_len++] = static_cast<uint8_t>(acc >> bits);
+        }
+    }
+    return static_cast<ssize_t>(out_len);
+}
+
+// Base64エンコード（outには4*ceil(len/3)バイト必要）。書き込んだ長さを返す
+static size_t encodeBase64(const uint8_t* in, size_t len, char* out) {
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t out_len = 0;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out[out_len++] = chars[(v >> 18) & 0x3F];
+        out[out_len++] = chars[(v >> 12) & 0x3F];
+        out[out_len++] = chars[(v >> 6) & 0x3F];
+        out[out_len++] = chars[v & 0x3F];
+    }
+    if (i < len) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < len) {
+            v |= in[i + 1] << 8;
+        }
+        out[out_len++] = chars[(v >> 18) & 0x3F];
+        out[out_len++] = chars[(v >> 12) & 0x3F];
+        out[out_len++] = (i + 1 < len) ? chars[(v >> 6) & 0x3F] : '=';
+        out[out_len++] = '=';
+    }
+    return out_len;
+}
+
+// TX:<MAC>|<Base64>\n を組み立てて長さを返す
+static size_t formatTxLine(char* out, std::string_view mac, const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    memcpy(out, "TX:", 3);
+    pos += 3;
+    memcpy(out + pos, mac.data(), mac.size());
+    pos += mac.size();
+    out[pos++] = '|';
+    pos += encodeBase64(data, len, out + pos);
+    out[pos++] = '\n';
+    return pos;
+}
 
 UARTReceiver::UARTReceiver(const std::string& device, int baudrate)
-    : device_(device), baudrate_(baudrate), fd_(-1), running_(false) {}
+    : device_(device), baudrate_(baudrate), fd_(-1), running_(false),
+      line_len_(0), line_overflow_(false), tx_head_(0), tx_count_(0), tx_async_(false), tx_dropped_(0),
+      tx_discarded_(0), detached_(false), capture_(nullptr), rtscts_(false), actual_baudrate_(baudrate),
+      rx_bytes_(0), rx_lines_(0), rx_corrupt_(0), rx_overlong_(0) {}
 
 UARTReceiver::~UARTReceiver() {
     stop();
 }
 
 void UARTReceiver::start() {
+    if (fd_ < 0 && !openPort(false)) {
+        return;
+    }
+
+    // 受信スレッド・TXライタースレッド開始
+    running_ = true;
+    recv_thread_ = std::thread(&UARTReceiver::receiveLoop, this);
+    tx_thread_ = std::thread(&UARTReceiver::txLoop, this);
+    tx_async_ = true;
+}
+
+bool UARTReceiver::openPort(bool nonblocking) {
     // UARTデバイスを開く
-    fd_ = open(device_.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
+    int flags = O_RDWR | O_NOCTTY | O_SYNC;
+    if (nonblocking) {
+        flags |= O_NONBLOCK;
+    }
+
+    fd_ = open(device_.c_str(), flags);
     if (fd_ < 0) {
         std::cerr << "Error opening " << device_ << ": " << strerror(errno) << std::endl;
-        return;
+        return false;
     }
 
     // UART設定
@@ -30,25 +130,19 @@ void UARTReceiver::start() {
         std::cerr << "Error from tcgetattr: " << strerror(errno) << std::endl;
         close(fd_);
         fd_ = -1;
-        return;
+        return false;
     }
 
-    // ボーレート設定
-    speed_t baud = B115200;
-    if (baudrate_ == 9600) baud = B9600;
-    else if (baudrate_ == 19200) baud = B19200;
-    else if (baudrate_ == 38400) baud = B38400;
-    else if (baudrate_ == 57600) baud = B57600;
-    else if (baudrate_ == 115200) baud = B115200;
-
-    cfsetospeed(&tty, baud);
-    cfsetispeed(&tty, baud);
-
     // 8N1モード
     tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
     tty.c_cflag &= ~(PARENB | PARODD);
     tty.c_cflag &= ~CSTOPB;
-    tty.c_cflag &= ~CRTSCTS;
+    if (rtscts_) {
+        // 高速時にESP32側の受信が間に合わなくても取りこぼさないようにする
+        tty.c_cflag |= CRTSCTS;
+    } else {
+        tty.c_cflag &= ~CRTSCTS;
+    }
     tty.c_cflag |= (CLOCAL | CREAD);
 
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);
@@ -64,106 +158,495 @@ void UARTReceiver::start() {
         std::cerr << "Error from tcsetattr: " << strerror(errno) << std::endl;
         close(fd_);
         fd_ = -1;
-        return;
+        return false;
     }
 
-    // 受信スレッド開始
-    running_ = true;
-    recv_thread_ = std::thread(&UARTReceiver::receiveLoop, this);
+    // ボーレート設定（termiosの定数にない値も設定できるよう別に行う）
+    if (!SerialLink::setBaudrate(fd_, baudrate_, actual_baudrate_)) {
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    // UARTのクロックで表せない速度は近い値に丸められる（2%を超えると受信側でフレーミングエラーになりやすい）
+    if (std::abs(actual_baudrate_ - baudrate_) * 50 > baudrate_) {
+        std::cerr << "Warning: " << device_ << " runs at " << actual_baudrate_
+                  << " baud instead of " << baudrate_ << std::endl;
+    }
+
+    SerialLink::readCounters(fd_, icount_base_);
+    return true;
 }
 
 void UARTReceiver::stop() {
-    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        running_ = false;
+        tx_async_ = false;
+    }
+    tx_cv_.notify_all();
+
     if (recv_thread_.joinable()) {
         recv_thread_.join();
     }
+    if (tx_thread_.joinable()) {
+        tx_thread_.join();
+    }
     if (fd_ >= 0) {
         close(fd_);
         fd_ = -1;
     }
 }
 
-bool UARTReceiver::sendTxCommand(const std::string& mac, const std::vector<uint8_t>& data) {
-    if (fd_ < 0) {
+bool UARTReceiver::sendTxCommand(std::string_view mac, const std::vector<uint8_t>& data) {
+    return sendTxCommand(mac, data.data(), data.size());
+}
+
+bool UARTReceiver::sendTxCommand(std::string_view mac, const uint8_t* data, size_t len) {
+    if (fd_ < 0 && !detached_) {
         return false;
     }
 
-    // Base64エンコード
-    std::string encoded = base64_encode(data.data(), data.size());
-
     // フォーマット: TX:<MAC>|<Base64>\n
-    std::string command = "TX:" + mac + "|" + encoded + "\n";
+    size_t line_len = txLineLength(mac.size(), len);
+    if (line_len > kMaxLineSize) {
+        std::cerr << "TX command too long: " << line_len << " bytes" << std::endl;
+        return false;
+    }
 
-    ssize_t written = write(fd_, command.c_str(), command.size());
-    if (written < 0) {
+    // リプレイ中は書き込まずに記録だけする（再生結果の比較用）
+    if (detached_) {
+        char line[kMaxLineSize];
+        formatTxLine(line, mac, data, len);
+        if (capture_) {
+            capture_->record(TrafficCapture::Direction::Tx, line, line_len - 1);
+        }
+        tx_discarded_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // TXライターが動いていなければ呼び出しスレッドで直接書き込む
+    if (!tx_async_) {
+        char line[kMaxLineSize];
+        formatTxLine(line, mac, data, len);
+        if (!writeLine(line, line_len)) {
+            return false;
+        }
+        PacketTracer::mark(TraceStage::Written);
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(tx_mutex_);
+    if (tx_count_ == kTxQueueSize) {
+        lock.unlock();
+        tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "TX queue full, dropping command to " << mac << std::endl;
+        return false;
+    }
+
+    // キューのスロットへ直接エンコード
+    TxSlot& slot = tx_queue_[(tx_head_ + tx_count_) % kTxQueueSize];
+    slot.len = formatTxLine(slot.line, mac, data, len);
+    slot.enqueuedNs = JitterProbe::nowNs();
+    slot.traceId = PacketTracer::currentId();
+    tx_count_++;
+    lock.unlock();
+
+    tx_cv_.notify_one();
+    return true;
+}
+
+bool UARTReceiver::writeLine(const char* line, size_t len) {
+    size_t offset = 0;
+
+    while (offset < len) {
+        ssize_t written = write(fd_, line + offset, len - offset);
+        if (written > 0) {
+            offset += static_cast<size_t>(written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 送信バッファが空くまで待つ（ノンブロッキングfdのみ）
+            struct pollfd pfd = {fd_, POLLOUT, 0};
+            if (poll(&pfd, 1, 100) > 0) {
+                continue;
+            }
+        }
         std::cerr << "UART write error: " << strerror(errno) << std::endl;
         return false;
     }
 
+    // 改行を除いて記録
+    if (capture_) {
+        capture_->record(TrafficCapture::Direction::Tx, line, len - 1);
+    }
     return true;
 }
 
+void UARTReceiver::txLoop() {
+    Realtime::applyToCurrentThread(realtime_, GatewayThread::UartTx);
+
+    char line[kMaxLineSize];
+
+    while (true) {
+        size_t len;
+        uint32_t trace_id;
+        {
+            std::unique_lock<std::mutex> lock(tx_mutex_);
+            tx_cv_.wait(lock, [this] { return tx_count_ > 0 || !running_; });
+            if (tx_count_ == 0) {
+                break;
+            }
+
+            TxSlot& slot = tx_queue_[tx_head_];
+            len = slot.len;
+            trace_id = slot.traceId;
+            memcpy(line, slot.line, len);
+            if (realtime_.enabled) {
+                tx_jitter_.record(JitterProbe::nowNs() - slot.enqueuedNs);
+            }
+            tx_head_ = (tx_head_ + 1) % kTxQueueSize;
+            tx_count_--;
+        }
+
+        if (writeLine(line, len)) {
+            PacketTracer::mark(trace_id, TraceStage::Written);
+        }
+    }
+}
+
 void UARTReceiver::setRxCallback(std::function<void(const RxPacket&)> callback) {
     rx_callback_ = callback;
 }
 
 void UARTReceiver::receiveLoop() {
-    std::string buffer;
+    Realtime::applyToCurrentThread(realtime_, GatewayThread::UartRx);
+
     char read_buf[256];
 
     while (running_) {
-        ssize_t n = read(fd_, read_buf, sizeof(read_buf) - 1);
+        ssize_t n = read(fd_, read_buf, sizeof(read_buf));
         if (n > 0) {
-            read_buf[n] = '\0';
-            buffer += read_buf;
-
-            // 完全な行を処理
-            size_t pos;
-            while ((pos = buffer.find('\n')) != std::string::npos) {
-                std::string line = buffer.substr(0, pos);
-                buffer.erase(0, pos + 1);
-
-                RxPacket packet;
-                if (parseLine(line, packet) && rx_callback_) {
-                    rx_callback_(packet);
-                }
-            }
+            consumeBytes(read_buf, static_cast<size_t>(n));
         } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
             std::cerr << "UART read error: " << strerror(errno) << std::endl;
             break;
         }
-        usleep(1000); // 1msスリープ
+
+        if (realtime_.enabled) {
+            // 1msスリープの寝過ごし量を起床遅延として記録
+            uint64_t before = JitterProbe::nowNs();
+            usleep(1000);
+            uint64_t slept = JitterProbe::nowNs() - before;
+            rx_jitter_.record(slept > 1000000 ? slept - 1000000 : 0);
+        } else {
+            usleep(1000); // 1msスリープ
+        }
     }
 }
 
-bool UARTReceiver::parseLine(const std::string& line, RxPacket& packet) {
+void UARTReceiver::handleReadable() {
+    char read_buf[256];
+
+    // ノンブロッキングfdから読めるだけ読む
+    while (true) {
+        ssize_t n = read(fd_, read_buf, sizeof(read_buf));
+        if (n > 0) {
+            consumeBytes(read_buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            std::cerr << "UART read error: " << strerror(errno) << std::endl;
+        }
+        return;
+    }
+}
+
+void UARTReceiver::consumeBytes(const char* data, size_t len) {
+    rx_bytes_.fetch_add(len, std::memory_order_relaxed);
+
+    while (len > 0) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', len));
+        size_t chunk = newline ? static_cast<size_t>(newline - data) : len;
+
+        // 行バッファに追記（溢れた行は次の改行まで破棄）
+        if (line_len_ + chunk > kMaxLineSize) {
+            if (!line_overflow_) {
+                rx_overlong_.fetch_add(1, std::memory_order_relaxed);
+            }
+            line_overflow_ = true;
+        } else {
+            memcpy(line_buf_ + line_len_, data, chunk);
+            line_len_ += chunk;
+        }
+
+        if (!newline) {
+            return;
+        }
+
+        // 完全な行を処理
+        if (!line_overflow_) {
+            handleLine(std::string_view(line_buf_, line_len_));
+        }
+
+        line_len_ = 0;
+        line_overflow_ = false;
+        data += chunk + 1;
+        len -= chunk + 1;
+    }
+}
+
+bool UARTReceiver::injectLine(std::string_view line) {
+    return handleLine(line);
+}
+
+bool UARTReceiver::handleLine(std::string_view line) {
+    PacketTracer::begin(TracePath::Uplink);
+
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    if (capture_) {
+        capture_->record(TrafficCapture::Direction::Rx, line.data(), line.size());
+    }
+
+    RxPacket packet;
+    bool parsed = parseLine(line, packet);
+    rx_lines_.fetch_add(1, std::memory_order_relaxed);
+    if (!parsed && line.substr(0, 3) == "RX:") {
+        rx_corrupt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (parsed && rx_callback_) {
+        PacketTracer::mark(TraceStage::Decoded);
+        rx_callback_(packet);
+    }
+    PacketTracer::setCurrentId(0);
+    return parsed;
+}
+
+bool UARTReceiver::parseLine(std::string_view line, RxPacket& packet) {
     // フォーマット: RX:<MAC>|<len>|<Base64>
     if (line.substr(0, 3) != "RX:") {
         return false;
     }
 
     size_t first_pipe = line.find('|', 3);
-    if (first_pipe == std::string::npos) {
+    if (first_pipe == std::string_view::npos) {
         return false;
     }
 
     size_t second_pipe = line.find('|', first_pipe + 1);
-    if (second_pipe == std::string::npos) {
+    if (second_pipe == std::string_view::npos) {
         return false;
     }
 
     // MAC抽出
-    packet.sender_mac = line.substr(3, first_pipe - 3);
+    if (!MacAddress::parse(line.substr(3, first_pipe - 3), packet.sender_mac)) {
+        return false;
+    }
 
     // 長さ抽出
-    std::string len_str = line.substr(first_pipe + 1, second_pipe - first_pipe - 1);
-    packet.data_len = std::stoi(len_str);
+    const char* len_begin = line.data() + first_pipe + 1;
+    const char* len_end = line.data() + second_pipe;
+    auto result = std::from_chars(len_begin, len_end, packet.data_len);
+    if (result.ec != std::errc() || result.ptr != len_end) {
+        return false;
+    }
 
-    // Base64抽出とデコード
-    std::string encoded = line.substr(second_pipe + 1);
-    std::string decoded = base64_decode(encoded);
+    // Base64をプールのバッファへ直接デコード
+    packet.payload = pool_.acquire();
+    if (!packet.payload.valid()) {
+        std::cerr << "RX buffer pool exhausted, dropping packet" << std::endl;
+        return false;
+    }
 
-    packet.payload.assign(decoded.begin(), decoded.end());
+    ssize_t decoded = decodeBase64(line.substr(second_pipe + 1),
+                                   packet.payload.data(), packet.payload.capacity());
+    if (decoded < 0) {
+        return false;
+    }
+    packet.payload.resize(static_cast<size_t>(decoded));
 
     return true;
 }
+
+void UARTReceiver::reportLink(std::ostream& os) const {
+    os << "[uart] baud=" << actual_baudrate_ << " rtscts=" << (rtscts_ ? "on" : "off")
+       << " rx_bytes=" << rx_bytes_.load(std::memory_order_relaxed)
+       << " rx_lines=" << rx_lines_.load(std::memory_order_relaxed)
+       << " corrupt=" << rx_corrupt_.load(std::memory_order_relaxed)
+       << " overlong=" << rx_overlong_.load(std::memory_order_relaxed)
+       << " tx_dropped=" << tx_dropped_.load(std::memory_order_relaxed);
+    // ポートが閉じている・読み出せない場合はsupported=falseのままn/aと出す（0と区別する）
+    SerialLink::ErrorCounters now;
+    if (fd_ >= 0) {
+        SerialLink::readCounters(fd_, now);
+    }
+    os << " ";
+    now.since(icount_base_).print(os);
+    os << "\n";
+}
+
+bool UARTReceiver::runSelfTest(uint32_t duration_ms, std::ostream& os) {
+    if (!openPort(true)) {
+        return false;
+    }
+    tcflush(fd_, TCIOFLUSH);
+
+    SerialLink::ErrorCounters before;
+    SerialLink::readCounters(fd_, before);
+
+    // テスト行: "TS:<番号>|<Base64(番号から作る疑似乱数48バイト)>\n"（実際のRX行と同程度の長さ）
+    static constexpr size_t kTestPayload = 48;
+    auto fill = [](uint32_t seq, uint8_t* out) {
+        uint32_t x = seq * 2654435761u + 1;
+        for (size_t i = 0; i < kTestPayload; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            out[i] = static_cast<uint8_t>(x);
+        }
+    };
+
+    uint32_t sent = 0;
+    uint32_t expected = 0;
+    uint64_t received = 0;
+    uint64_t corrupt = 0;
+    uint64_t lost = 0;
+    uint64_t good_bytes = 0;
+
+    auto verify = [&](std::string_view line) {
+        uint8_t want[kTestPayload];
+        uint8_t got[kTestPayload + 3];
+        size_t pipe = line.find('|');
+        uint32_t seq = 0;
+        if (line.substr(0, 3) != "TS:" || pipe == std::string_view::npos ||
+            std::from_chars(line.data() + 3, line.data() + pipe, seq).ptr != line.data() + pipe ||
+            seq < expected || seq >= sent ||
+            decodeBase64(line.substr(pipe + 1), got, sizeof(got)) != static_cast<ssize_t>(kTestPayload)) {
+            corrupt++;
+            return;
+        }
+        fill(seq, want);
+        if (memcmp(want, got, kTestPayload) != 0) {
+            corrupt++;
+            return;
+        }
+        lost += seq - expected;
+        expected = seq + 1;
+        received++;
+        good_bytes += line.size() + 1;
+    };
+
+    char tx_line[kMaxLineSize];
+    size_t tx_len = 0;
+    size_t tx_offset = 0;
+    char rx_line[kMaxLineSize];
+    size_t rx_len = 0;
+    bool rx_overflow = false;
+    char read_buf[256];
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::milliseconds(duration_ms);
+    Clock::time_point last_rx = start;
+
+    os << "[serial-test] " << device_ << " baud=" << actual_baudrate_
+       << " rtscts=" << (rtscts_ ? "on" : "off") << " duration=" << duration_ms << "ms" << std::endl;
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        bool sending = now < deadline;
+        if (!sending && now - last_rx > std::chrono::milliseconds(300)) {
+            // 送信をやめてから折り返しが途絶えたら終了
+            break;
+        }
+        if (received == 0 && corrupt == 0 && now - start > std::chrono::seconds(1)) {
+            // 折り返しがない
+            break;
+        }
+
+        struct pollfd pfd = {fd_, static_cast<short>(POLLIN | (sending ? POLLOUT : 0)), 0};
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+
+        if ((pfd.revents & POLLOUT) && sending) {
+            if (tx_offset == tx_len) {
+                uint8_t payload[kTestPayload];
+                fill(sent, payload);
+                int n = snprintf(tx_line, sizeof(tx_line), "TS:%u|", sent);
+                tx_len = static_cast<size_t>(n) + encodeBase64(payload, kTestPayload, tx_line + n);
+                tx_line[tx_len++] = '\n';
+                tx_offset = 0;
+                sent++;
+            }
+            ssize_t written = write(fd_, tx_line + tx_offset, tx_len - tx_offset);
+            if (written > 0) {
+                tx_offset += static_cast<size_t>(written);
+            }
+        }
+
+        if (pfd.revents & POLLIN) {
+            ssize_t n = read(fd_, read_buf, sizeof(read_buf));
+            if (n <= 0) {
+                continue;
+            }
+            last_rx = Clock::now();
+            for (ssize_t i = 0; i < n; i++) {
+                if (read_buf[i] != '\n') {
+                    if (rx_len < sizeof(rx_line)) {
+                        rx_line[rx_len++] = read_buf[i];
+                    } else {
+                        rx_overflow = true;
+                    }
+                    continue;
+                }
+                if (rx_overflow) {
+                    corrupt++;
+                } else {
+                    verify(std::string_view(rx_line, rx_len));
+                }
+                rx_len = 0;
+                rx_overflow = false;
+            }
+        }
+    }
+
+    SerialLink::ErrorCounters after;
+    SerialLink::readCounters(fd_, after);
+    SerialLink::ErrorCounters errors = after.since(before);
+    close(fd_);
+    fd_ = -1;
+
+    if (received == 0 && corrupt == 0) {
+        os << "[serial-test] nothing came back: connect TX to RX (and RTS to CTS with --rtscts) "
+           << "and disconnect the ESP32" << std::endl;
+        return false;
+    }
+
+    // 書きかけの最後の行は数えない
+    if (tx_offset < tx_len) {
+        sent--;
+    }
+    lost += sent > expected ? sent - expected : 0;
+
+    double elapsed = std::chrono::duration<double>(last_rx - start).count();
+    double throughput = elapsed > 0 ? good_bytes / elapsed : 0;
+    double line_rate = actual_baudrate_ / 10.0;     // 8N1: 1バイト10ビット
+
+    os << "[serial-test] sent=" << sent << " received=" << received
+       << " lost=" << lost << " corrupt=" << corrupt << std::endl;
+    os << "[serial-test] throughput=" << static_cast<uint64_t>(throughput) << " bytes/s ("
+       << std::fixed << std::setprecision(1) << throughput * 100 / line_rate << "% of "
+       << static_cast<uint64_t>(line_rate) << ")" << std::endl;
+    os << "[serial-test] ";
+    errors.print(os);
+    os << std::endl;
+
+    bool stable = lost == 0 && corrupt == 0 && errors.errors() == 0;
+    os << "[serial-test] result: " << (stable ? "stable" : "errors (try a lower rate or --rtscts)") << std::endl;
+    return stable;
+}
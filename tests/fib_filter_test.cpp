@@ -0,0 +1,132 @@
+// GatewayFIBの否定キャッシュ（カウンティングBloomフィルタ）の確認
+// - 学習・保存した経路はフィルタを通過して見つかる（偽陰性がない）
+// - 削除・LRU追い出しでフィルタからも消え、以後は即座に棄却される
+// - より近い経路で置き換えた次ホップ
+// - 経路のない名前の偽陽性率と統計の整合
+#include <cstdio>
+#include <string>
+#include "gateway_fib.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static std::string routeName(size_t i) {
+    return "/sensor/room" + std::to_string(i) + "/temp";
+}
+
+int main() {
+    MacAddress mac;
+    MacAddress::parse("AA:BB:CC:DD:EE:FF", mac);
+
+    // 学習した経路と、その下位の名前（LPM）は棄却されない
+    {
+        GatewayFIB fib;
+        fib.learn("/sensor/room1/temp", mac);
+        bool rejected = true;
+        check(fib.lookup("/sensor/room1/temp", &rejected).size() == 1 && !rejected, "learned route is found");
+        check(fib.lookup("/sensor/room1/temp/123", &rejected).size() == 1 && !rejected,
+              "name below a learned route is found");
+        fib.lookup("/other/name", &rejected);
+        check(rejected, "unrelated name is rejected by the filter");
+
+        fib.remove("/sensor/room1/temp");
+        check(fib.lookup("/sensor/room1/temp", &rejected).empty() && rejected,
+              "removed route is rejected by the filter");
+    }
+
+    // 集約した経路（プレフィックス）も下位の名前で見つかる
+    {
+        GatewayFIB fib(3, 2);
+        fib.learn("/sensor/room1/temp", mac);
+        bool rejected = true;
+        check(fib.lookup("/sensor/room1/humid", &rejected).size() == 1 && !rejected,
+              "aggregated route is found");
+    }
+
+    // より近い経路で置き換えると遠い経路は検索結果に残らない
+    {
+        GatewayFIB fib;
+        MacAddress near;
+        MacAddress::parse("AA:BB:CC:DD:EE:01", near);
+        fib.learn("/sensor/room1/temp", mac);
+        fib.replace("/sensor/room1/temp", mac, near);
+        std::set<std::string> hops = fib.lookup("/sensor/room1/temp");
+        check(hops.size() == 1 && hops.count(near.toString()) == 1, "worse next hop is replaced");
+    }
+
+    // LRUで追い出された経路はフィルタからも消える
+    {
+        GatewayFIB fib;
+        for (size_t i = 0; i < GatewayFIB::kCapacity * 2; i++) {
+            fib.learn(routeName(i), mac);
+        }
+        check(fib.size() == GatewayFIB::kCapacity, "FIB holds kCapacity entries");
+
+        size_t rejected_count = 0;
+        size_t found = 0;
+        for (size_t i = 0; i < GatewayFIB::kCapacity * 2; i++) {
+            bool rejected = false;
+            bool hit = !fib.lookup(routeName(i), &rejected).empty();
+            if (i < GatewayFIB::kCapacity) {
+                check(!hit, "evicted route is not found");
+                rejected_count += rejected ? 1 : 0;
+            } else {
+                check(hit && !rejected, "live route is found");
+                found += hit ? 1 : 0;
+            }
+        }
+        check(found == GatewayFIB::kCapacity, "every live route is found");
+        // 追い出した名前は（偽陽性を除いて）フィルタで棄却される
+        check(rejected_count >= GatewayFIB::kCapacity * 95 / 100, "evicted routes are rejected by the filter");
+        std::printf("evicted routes rejected by the filter: %zu/%zu\n", rejected_count, GatewayFIB::kCapacity);
+    }
+
+    // 満杯のFIBに対する経路のない名前の偽陽性率と統計
+    {
+        GatewayFIB fib;
+        for (size_t i = 0; i < GatewayFIB::kCapacity; i++) {
+            fib.learn(routeName(i), mac);
+        }
+        GatewayFIB::FilterStats before = fib.filterStats();
+
+        const size_t kProbes = 100000;
+        size_t rejected_count = 0;
+        for (size_t i = 0; i < kProbes; i++) {
+            bool rejected = false;
+            std::string name = "/scan/" + std::to_string(i) + "/x";
+            check(fib.lookup(name, &rejected).empty(), "unroutable name has no route");
+            rejected_count += rejected ? 1 : 0;
+        }
+
+        GatewayFIB::FilterStats after = fib.filterStats();
+        uint64_t rejected = after.rejected - before.rejected;
+        uint64_t passed = after.passed - before.passed;
+        uint64_t false_positives = after.falsePositives - before.falsePositives;
+        check(rejected == rejected_count, "rejected counter matches");
+        check(rejected + passed == kProbes, "every lookup is counted once");
+        check(false_positives == passed, "every passed unroutable name is a false positive");
+
+        double rate = static_cast<double>(false_positives) / kProbes;
+        std::printf("false positive rate: %.4f (%llu/%zu)\n", rate,
+                    static_cast<unsigned long long>(false_positives), kProbes);
+        check(rate < 0.02, "false positive rate is below 2%");
+
+        // 無効にするとすべてLPMを実行し、フィルタの統計は増えない
+        fib.setFilterEnabled(false);
+        bool was_rejected = true;
+        fib.lookup("/scan/x/y", &was_rejected);
+        GatewayFIB::FilterStats disabled = fib.filterStats();
+        check(!was_rejected, "disabled filter does not reject");
+        check(disabled.rejected == after.rejected && disabled.passed == after.passed &&
+              disabled.falsePositives == after.falsePositives, "disabled filter is not counted");
+    }
+
+    std::printf("fib_filter_test: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// FibReplicatorの複製の確認（127.0.0.1上の2ノード、ユニキャスト）
+// 受信スレッドは使わずイベントループモードと同じくfd()をpollしてhandleReadable()を呼ぶ
+// 途中のデータグラムは受信側のソケットから直接読み捨てて「取りこぼし」を作る
+// - 差分の即時複製で経路が収束する
+// - 差分を1つ落とすと、次の差分で抜けを検出し、ダイジェスト→履歴からの再送で埋まる
+// - 履歴（kLogSize）より多く取りこぼすと、FIB全体（複数データグラムのスナップショット）で埋まる
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <poll.h>
+#include <sys/socket.h>
+#include "fib_replicator.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static uint64_t nowMs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+// 両ノードの受信と周期処理をdone()が真になるか時間切れまで回す
+template<typename Done>
+static bool pump(FibReplicator& a, FibReplicator& b, uint32_t timeout_ms, Done&& done) {
+    uint64_t deadline = nowMs() + timeout_ms;
+    while (nowMs() < deadline) {
+        struct pollfd pfds[2] = {{a.fd(), POLLIN, 0}, {b.fd(), POLLIN, 0}};
+        if (poll(pfds, 2, 10) > 0) {
+            if (pfds[0].revents & POLLIN) {
+                a.handleReadable();
+            }
+            if (pfds[1].revents & POLLIN) {
+                b.handleReadable();
+            }
+        }
+        uint64_t now = nowMs();
+        a.tick(now);
+        b.tick(now);
+        if (done()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 周期処理を止めて、届いているデータグラム（とその応答）を処理し尽くす
+static void settle(FibReplicator& a, FibReplicator& b) {
+    struct pollfd pfds[2] = {{a.fd(), POLLIN, 0}, {b.fd(), POLLIN, 0}};
+    while (poll(pfds, 2, 50) > 0) {
+        a.handleReadable();
+        b.handleReadable();
+    }
+}
+
+// 届いているデータグラムを処理せずに捨て、捨てた数を返す
+static size_t discard(int fd, uint32_t wait_ms) {
+    size_t dropped = 0;
+    uint8_t buf[FibReplicator::kMaxDatagram];
+    struct pollfd pfd = {fd, POLLIN, 0};
+    while (poll(&pfd, 1, static_cast<int>(wait_ms)) > 0) {
+        while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) >= 0) {
+            dropped++;
+        }
+        wait_ms = 0;
+    }
+    return dropped;
+}
+
+static std::string peerApplied(uint32_t peer, uint32_t seq) {
+    std::ostringstream line;
+    line << "peer=" << std::hex << peer << std::dec << " applied=" << seq << "\n";
+    return line.str();
+}
+
+static bool hasApplied(const FibReplicator& node, uint32_t peer, uint32_t seq) {
+    std::ostringstream report;
+    node.report(report);
+    return report.str().find(peerApplied(peer, seq)) != std::string::npos;
+}
+
+int main() {
+    ReplicationConfig config_a;
+    config_a.enabled = true;
+    config_a.port = 47811;
+    config_a.peers = {"127.0.0.1:47812"};
+    config_a.sync_interval_ms = 50;
+    ReplicationConfig config_b = config_a;
+    config_b.port = 47812;
+    config_b.peers = {"127.0.0.1:47811"};
+
+    GatewayFIB fib_a;
+    GatewayFIB fib_b;
+    FibReplicator a(fib_a, config_a);
+    FibReplicator b(fib_b, config_b);
+    if (!a.open() || !b.open()) {
+        std::fprintf(stderr, "FAILED: open replication sockets\n");
+        return 1;
+    }
+
+    MacAddress mac;
+    MacAddress::parse("AA:BB:CC:DD:EE:01", mac);
+    auto learn = [&](const std::string& name) {
+        fib_a.learn(name, mac);
+        a.announce(name, mac);
+    };
+
+    // 起動時のダイジェストを交換して互いを知る
+    pump(a, b, 200, [] { return false; });
+
+    // 差分の即時複製
+    learn("/sensor/room1/temp");
+    check(pump(a, b, 2000, [&] { return fib_b.find("/sensor/room1/temp"); }), "learned route converges");
+    check(pump(a, b, 2000, [&] { return hasApplied(b, a.nodeId(), 1); }), "peer applied seq 1");
+
+    // 差分を1つ落とす → 次の差分で抜けを検出して再送させる
+    settle(a, b);
+    learn("/sensor/room2/temp");
+    check(discard(b.fd(), 500) == 1, "dropped one delta");
+    check(!fib_b.find("/sensor/room2/temp"), "dropped route is not learned yet");
+    learn("/sensor/room3/temp");
+    check(pump(a, b, 3000, [&] {
+        return fib_b.find("/sensor/room2/temp") && fib_b.find("/sensor/room3/temp") &&
+               hasApplied(b, a.nodeId(), 3);
+    }), "dropped delta is repaired");
+    check(b.stats().gaps >= 1, "gap is detected");
+    check(a.stats().resent >= 1, "delta is resent from the log");
+    check(a.stats().snapshots == 0, "no snapshot for a short gap");
+
+    // 履歴より多く取りこぼす → スナップショットで埋める
+    // 名前は先頭で分かれる長いものにして、スナップショットが複数のデータグラムになるようにする
+    auto snapshotName = [](size_t i) {
+        return "/snapshot" + std::to_string(i) + "/" + std::string(80, 'v');
+    };
+    const size_t kUpdates = FibReplicator::kLogSize + 20;
+    for (size_t i = 0; i < kUpdates; i++) {
+        MacAddress hop = mac;
+        hop.bytes[5] = static_cast<uint8_t>(2 + i / 60);
+        std::string name = snapshotName(i % 60);
+        fib_a.learn(name, hop);
+        a.announce(name, hop);
+        if (i % 32 == 31) {
+            discard(b.fd(), 0);
+        }
+    }
+    discard(b.fd(), 100);
+    check(!fib_b.find(snapshotName(0)), "flooded routes are not learned yet");
+
+    uint32_t last_seq = static_cast<uint32_t>(3 + kUpdates);
+    check(pump(a, b, 5000, [&] { return hasApplied(b, a.nodeId(), last_seq); }),
+          "snapshot brings the peer up to date");
+    check(a.stats().snapshots >= 1, "snapshot is sent");
+    bool all = true;
+    for (size_t i = 0; i < 60; i++) {
+        all = all && fib_b.find(snapshotName(i));
+    }
+    check(all, "every snapshot route is learned");
+    check(fib_b.find("/sensor/room1/temp"), "earlier routes are kept");
+    check(a.stats().rejected == 0 && b.stats().rejected == 0, "no datagram is rejected");
+
+    a.report(std::cout);
+    b.report(std::cout);
+    std::printf("fib_replicator_test: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
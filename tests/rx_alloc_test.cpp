@@ -0,0 +1,143 @@
+// RX経路（UART行の解析 → プールへのBase64デコード → ICSNフレームのビュー → フラグメント再構築）が
+// 定常状態でヒープ確保をしないことを、operator newを数えて確かめる
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "uart_receiver.h"
+#include "packet_parser.h"
+#include "fragment_reassembler.h"
+#include "third_party/base64.h"
+
+static std::atomic<bool> g_counting{false};
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    if (g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+static std::string rxLine(const std::vector<uint8_t>& frame) {
+    return "RX:AA:BB:CC:DD:EE:FF|" + std::to_string(frame.size()) + "|" +
+           base64_encode(frame.data(), frame.size());
+}
+
+// v1 DATAフレーム: [版][種別][ホップ][名前長][内容長][名前][内容]
+static std::vector<uint8_t> dataFrame(const std::string& name, const std::vector<uint8_t>& content) {
+    std::vector<uint8_t> frame = {1, static_cast<uint8_t>(IcsnSignal::Data), 1,
+                                  static_cast<uint8_t>(name.size()), static_cast<uint8_t>(content.size())};
+    frame.insert(frame.end(), name.begin(), name.end());
+    frame.insert(frame.end(), content.begin(), content.end());
+    return frame;
+}
+
+// v1 FRAGフレーム: [版][種別][ホップ][名前長][ID下位][ID上位][番号][総数][データ長][名前][データ]
+static std::vector<uint8_t> fragmentFrame(const std::string& name, uint16_t id, uint8_t index, uint8_t count,
+                                          const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> frame = {1, static_cast<uint8_t>(IcsnSignal::Fragment), 1,
+                                  static_cast<uint8_t>(name.size()),
+                                  static_cast<uint8_t>(id & 0xFF), static_cast<uint8_t>(id >> 8),
+                                  index, count, static_cast<uint8_t>(data.size())};
+    frame.insert(frame.end(), name.begin(), name.end());
+    frame.insert(frame.end(), data.begin(), data.end());
+    return frame;
+}
+
+int main() {
+    const std::string name = "/sensor/room1/temp";
+    std::vector<uint8_t> reading = {0x00, 0x11, 0x00, 0x22, 0xFF, 0x00, 0x7F, 0x80};
+    std::vector<uint8_t> chunk(200);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    std::vector<std::string> lines;
+    lines.push_back(rxLine(dataFrame(name, reading)));
+    for (uint8_t i = 0; i < 3; i++) {
+        lines.push_back(rxLine(fragmentFrame(name, 42, i, 3, chunk)));
+    }
+
+    UARTReceiver uart("/dev/null", 115200);
+    uart.detach();
+    PacketParser parser;
+    FragmentReassembler reassembler;
+    std::string reassembled_name;
+    std::vector<uint8_t> reassembled_payload;
+    reassembled_name.reserve(sizeof(CommunicationData::contentName));
+    reassembled_payload.reserve(FragmentReassembler::kMaxMessageSize);
+
+    uint64_t data_packets = 0;
+    uint64_t messages = 0;
+    uart.setRxCallback([&](const RxPacket& packet) {
+        IcsnPacketView view;
+        if (!parser.parse(packet.payload.data(), packet.payload.size(), view)) {
+            return;
+        }
+        if (view.signal() == IcsnSignal::Fragment) {
+            if (reassembler.addFragment(packet.sender_mac, view, reassembled_name, reassembled_payload)) {
+                messages++;
+            }
+        } else if (view.signal() == IcsnSignal::Data && view.contentName() == name) {
+            data_packets++;
+        }
+    });
+
+    // 暖機（遅延初期化・容量確保を済ませる）
+    for (int i = 0; i < 100; i++) {
+        for (const std::string& line : lines) {
+            uart.injectLine(line);
+        }
+    }
+
+    const int kIterations = 10000;
+    data_packets = 0;
+    messages = 0;
+    g_allocations = 0;
+    g_counting = true;
+    for (int i = 0; i < kIterations; i++) {
+        for (const std::string& line : lines) {
+            uart.injectLine(line);
+        }
+    }
+    g_counting = false;
+
+    bool ok = true;
+    if (data_packets != kIterations || messages != kIterations) {
+        std::fprintf(stderr, "expected %d packets and messages, got %llu and %llu\n", kIterations,
+                     static_cast<unsigned long long>(data_packets), static_cast<unsigned long long>(messages));
+        ok = false;
+    }
+    if (reassembled_payload.size() != chunk.size() * 3 || reassembled_name != name) {
+        std::fprintf(stderr, "reassembled message is wrong (%zu bytes)\n", reassembled_payload.size());
+        ok = false;
+    }
+    if (g_allocations != 0) {
+        std::fprintf(stderr, "RX path allocated %llu times in %zu lines\n",
+                     static_cast<unsigned long long>(g_allocations.load()), kIterations * lines.size());
+        ok = false;
+    }
+
+    std::printf("rx_alloc_test: %zu lines, %llu allocations: %s\n", kIterations * lines.size(),
+                static_cast<unsigned long long>(g_allocations.load()), ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+// SensorHistoryの問い合わせの確認
+// CEFOREから届くInterestのURIは "ccnx:/..." で、記録はタイムスタンプを除いた "/..." で行うため、
+// MainController::answerFromHistoryと同じく末尾要素で分けて検索し、両者が一致することを確かめる
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "sensor_history.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// answerFromHistoryと同じ手順でInterestのURIに答える（答えられなければ-1）
+static long answer(const SensorHistory& history, std::string_view uri, uint8_t* out, size_t capacity) {
+    size_t last_slash = uri.rfind('/');
+    if (last_slash == std::string_view::npos || last_slash == 0) {
+        return -1;
+    }
+    SensorHistory::Query query;
+    if (!SensorHistory::parseQuery(uri.substr(last_slash + 1), query)) {
+        return -1;
+    }
+    return history.lookup(uri.substr(0, last_slash), query, out, capacity);
+}
+
+int main() {
+    SensorHistory history;
+    if (!history.open()) {
+        std::fprintf(stderr, "FAILED: open\n");
+        return 1;
+    }
+
+    const uint8_t first[] = {0x01, 0x02};
+    const uint8_t second[] = {0x03, 0x04, 0x05};
+    history.record("/sensor/room1/temp", 1000, first, sizeof(first));
+    history.record("/sensor/room1/temp", 2000, second, sizeof(second));
+
+    uint8_t out[SensorHistory::kValueStride * SensorHistory::kSamplesPerSeries];
+
+    long len = answer(history, "ccnx:/sensor/room1/temp/latest", out, sizeof(out));
+    check(len == sizeof(second) && out[0] == 0x03, "ccnx latest is answered from history");
+
+    len = answer(history, "/sensor/room1/temp/latest", out, sizeof(out));
+    check(len == sizeof(second), "plain latest is answered from history");
+
+    len = answer(history, "ccnx:/sensor/room1/temp/1000", out, sizeof(out));
+    check(len == sizeof(first) && out[0] == 0x01, "ccnx exact timestamp is answered from history");
+
+    len = answer(history, "ccnx:/sensor/room1/temp/1500", out, sizeof(out));
+    check(len < 0, "unknown timestamp is left to the forward path");
+
+    len = answer(history, "ccnx:/sensor/room1/temp/since=1500", out, sizeof(out));
+    check(len == static_cast<long>(SensorHistory::kRecordHeaderSize + sizeof(second)),
+          "ccnx since returns the newer reading");
+
+    len = answer(history, "ccnx:/sensor/room1/humid/latest", out, sizeof(out));
+    check(len < 0, "unknown name is not answered");
+
+    len = answer(history, "ccnx:/sensor/room1/temp/data", out, sizeof(out));
+    check(len < 0, "non-query component is not answered");
+
+    // "ccnx:" 付きで記録しても同じ系列になる
+    const uint8_t third[] = {0x06};
+    history.record("ccnx:/sensor/room1/temp", 3000, third, sizeof(third));
+    len = answer(history, "/sensor/room1/temp/latest", out, sizeof(out));
+    check(len == sizeof(third) && out[0] == 0x06, "ccnx record shares the series");
+    check(history.seriesCount() == 1, "one series");
+
+    std::printf("sensor_history_test: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}